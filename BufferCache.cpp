@@ -0,0 +1,172 @@
+#include "BufferCache.h"
+#include "ProtocolStats.h"
+
+#include <cstdio>
+#include <climits>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+bool CacheBudget::reserve(size_t bytes) {
+    size_t used = used_.load(std::memory_order_relaxed);
+    do {
+        if (bytes > limit_ || used > limit_ - bytes) return false;
+    } while (!used_.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
+    return true;
+}
+
+BufferCache::~BufferCache() {
+    clear();
+}
+
+bool BufferCache::populate(struct wl_shm* shm, const std::vector<uint32_t>& colors, int width, int height,
+                           uint32_t format, int pixel_size, std::vector<Entry*>& created) {
+    if (width == width_ && height == height_ && format == format_)
+        return true;
+    if (width == refused_width_ && height == refused_height_ && format == refused_format_)
+        return false;
+
+    retire_entries();
+
+    size_t stride = static_cast<size_t>(width) * pixel_size;
+    size_t size = stride * height;
+    if (width <= 0 || height <= 0 || size > INT32_MAX) {
+        fprintf(stderr, "BufferCache: invalid buffer size %dx%d\n", width, height);
+        return false;
+    }
+
+    // All or nothing. Memory still held for the previous size may be what
+    // is missing, so the size is only given up once none is left.
+    if (!budget_->reserve(size * colors.size())) {
+        bool held = !entries_.empty();
+        if (!held) {
+            refused_width_ = width;
+            refused_height_ = height;
+            refused_format_ = format;
+            stats_.refusals.fetch_add(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+    bytes_.fetch_add(size * colors.size(), std::memory_order_relaxed);
+
+    size_t first = created.size();
+    for (size_t i = 0; i < colors.size(); ++i) {
+        int fd = memfd_create("wayland-buffer-cache", MFD_CLOEXEC);
+        void* data = MAP_FAILED;
+        if (fd == -1) {
+            perror("memfd_create");
+        } else if (ftruncate(fd, size) == -1) {
+            perror("ftruncate");
+        } else if ((data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+            perror("mmap");
+        }
+        if (data == MAP_FAILED) {
+            if (fd != -1) close(fd);
+            // The entries made so far, first in the list, give their share
+            // back when destroyed
+            size_t unused = size * (colors.size() - i);
+            budget_->release(unused);
+            bytes_.fetch_sub(unused, std::memory_order_relaxed);
+            for (size_t made = 0; made < i; ++made) {
+                destroy_entry(entries_.front());
+                entries_.pop_front();
+            }
+            created.resize(first);
+            refused_width_ = width;
+            refused_height_ = height;
+            refused_format_ = format;
+            return false;
+        }
+
+        // The buffer keeps the memory alive; the pool and fd are not needed again
+        struct wl_shm_pool* pool = wl_shm_create_pool(shm, fd, static_cast<int32_t>(size));
+        protocol_request(1);
+        struct wl_buffer* buffer = wl_shm_pool_create_buffer(pool, 0, width, height,
+                                                             static_cast<int32_t>(stride), format);
+        protocol_request();
+        wl_shm_pool_destroy(pool);
+        protocol_request();
+        close(fd);
+
+        entries_.emplace_front();
+        Entry& entry = entries_.front();
+        entry.color = colors[i];
+        entry.width = width;
+        entry.height = height;
+        entry.format = format;
+        entry.size = size;
+        entry.data = data;
+        entry.buffer = buffer;
+        entry.owner = this;
+        wl_buffer_add_listener(buffer, &buffer_listener_impl, &entry);
+        created.push_back(&entry);
+    }
+
+    width_ = width;
+    height_ = height;
+    format_ = format;
+    stats_.builds.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+BufferCache::Entry* BufferCache::lookup(uint32_t color) {
+    for (auto& entry : entries_) {
+        if (entry.stale || entry.color != color) continue;
+        entry.busy = true;
+        stats_.hits.fetch_add(1, std::memory_order_relaxed);
+        return &entry;
+    }
+    return nullptr;
+}
+
+// Idle entries go now; one the compositor still holds may be on screen
+// and waits for its wl_buffer.release
+void BufferCache::retire_entries() {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->busy) {
+            it->stale = true;
+            ++it;
+        } else {
+            destroy_entry(*it);
+            it = entries_.erase(it);
+        }
+    }
+    width_ = height_ = 0;
+    format_ = 0;
+}
+
+void BufferCache::buffer_release(void* data, struct wl_buffer* buffer) {
+    Entry* entry = static_cast<Entry*>(data);
+    protocol_event(entry->owner->events_);
+    entry->busy = false;
+    if (!entry->stale) return;
+
+    BufferCache* cache = entry->owner;
+    cache->destroy_entry(*entry);
+    for (auto it = cache->entries_.begin(); it != cache->entries_.end(); ++it) {
+        if (&*it == entry) {
+            cache->entries_.erase(it);
+            return;
+        }
+    }
+}
+
+void BufferCache::destroy_entry(Entry& entry) {
+    if (entry.buffer) {
+        wl_buffer_destroy(entry.buffer);
+        protocol_request();
+    }
+    if (entry.data) munmap(entry.data, entry.size);
+    bytes_.fetch_sub(entry.size, std::memory_order_relaxed);
+    budget_->release(entry.size);
+}
+
+// The window is going away: nothing is waited for
+void BufferCache::clear() {
+    for (auto& entry : entries_) destroy_entry(entry);
+    entries_.clear();
+    width_ = height_ = 0;
+    format_ = 0;
+    refused_width_ = refused_height_ = 0;
+    refused_format_ = 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <vector>
+
+extern "C" {
+#include <wayland-client.h>
+}
+
+struct ProtocolStats;
+
+// Bytes the palette caches of all windows may hold together. Reservations
+// are all or nothing and may come from any thread.
+class CacheBudget {
+public:
+    explicit CacheBudget(size_t limit = 0) : limit_(limit) {}
+
+    void set_limit(size_t bytes) { limit_ = bytes; }
+    size_t limit() const { return limit_; }
+    size_t used() const { return used_.load(std::memory_order_relaxed); }
+
+    bool reserve(size_t bytes);
+    void release(size_t bytes) { used_.fetch_sub(bytes, std::memory_order_relaxed); }
+
+private:
+    size_t limit_ = 0;
+    std::atomic<size_t> used_{0};
+};
+
+// Per-window cache of fully rendered wl_buffers, one per palette color at
+// the window's size and format. Static content that comes back (the palette
+// colors) is drawn once, up front; showing it again is attach + damage +
+// commit with no pixel writes. A window gets the cache only when its whole
+// palette fits in what is left of the shared budget; otherwise it draws
+// through its ShmPool and nothing is evicted to make room. Entries of a
+// previous size are dropped on resize, or once the compositor releases
+// them. Counters are relaxed atomics so another thread may print them.
+class BufferCache {
+public:
+    struct Entry {
+        uint32_t color = 0;
+        int width = 0, height = 0;
+        uint32_t format = 0;
+        size_t size = 0;
+        void* data = nullptr;
+        struct wl_buffer* buffer = nullptr;
+        bool busy = false;
+        bool stale = false;          // Previous size, destroyed on release
+        BufferCache* owner = nullptr;
+    };
+
+    struct Stats {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> builds{0};     // Palettes rendered
+        std::atomic<uint64_t> refusals{0};   // Palettes that did not fit
+    };
+
+    BufferCache() = default;
+    ~BufferCache();
+
+    BufferCache(const BufferCache&) = delete;
+    BufferCache& operator=(const BufferCache&) = delete;
+
+    void set_budget(CacheBudget* budget) { budget_ = budget; }
+    bool enabled() const { return budget_ && budget_->limit(); }
+
+    // wl_buffer.release events are charged to stats (PROTOCOL_STATS builds)
+    void count_events(ProtocolStats* stats) { events_ = stats; }
+
+    // Makes sure every color of the palette has an entry at this size and
+    // format. Returns false, with no current entries, if the palette does
+    // not fit; a size that did not fit is not tried again until another
+    // size has been. Entries created by this call are appended to created
+    // and must be filled before any of them is attached.
+    bool populate(struct wl_shm* shm, const std::vector<uint32_t>& colors, int width, int height,
+                  uint32_t format, int pixel_size, std::vector<Entry*>& created);
+
+    // Ready buffer for color, marked busy, or nullptr if it has none
+    Entry* lookup(uint32_t color);
+
+    void clear();
+
+    size_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+    const Stats& stats() const { return stats_; }
+
+private:
+    static void buffer_release(void* data, struct wl_buffer* buffer);
+
+    static constexpr wl_buffer_listener buffer_listener_impl = {
+        .release = buffer_release
+    };
+
+    void retire_entries();
+    void destroy_entry(Entry& entry);
+
+    std::list<Entry> entries_;       // Current palette, then stale entries
+    CacheBudget* budget_ = nullptr;
+    ProtocolStats* events_ = nullptr;
+    std::atomic<size_t> bytes_{0};
+    int width_ = 0, height_ = 0;     // Size of the current palette
+    uint32_t format_ = 0;
+    int refused_width_ = 0, refused_height_ = 0;
+    uint32_t refused_format_ = 0;
+    Stats stats_;
+};
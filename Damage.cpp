@@ -0,0 +1,202 @@
+#include "Damage.h"
+
+#include <algorithm>
+#include <cstdint>
+
+bool Rect::contains(const Rect& other) const {
+    return other.x >= x && other.y >= y &&
+           other.x + other.width <= x + width && other.y + other.height <= y + height;
+}
+
+Rect Rect::intersected(const Rect& other) const {
+    Rect result;
+    result.x = std::max(x, other.x);
+    result.y = std::max(y, other.y);
+    result.width = std::min(x + width, other.x + other.width) - result.x;
+    result.height = std::min(y + height, other.y + other.height) - result.y;
+    return result;
+}
+
+// Append the parts of rect outside cut: the bands above and below it,
+// then the parts left and right of it in between
+static void subtract(const Rect& rect, const Rect& cut, std::vector<Rect>& out) {
+    Rect overlap = rect.intersected(cut);
+    if (overlap.empty()) {
+        out.push_back(rect);
+        return;
+    }
+    int bottom = rect.y + rect.height, right = rect.x + rect.width;
+    int overlap_bottom = overlap.y + overlap.height, overlap_right = overlap.x + overlap.width;
+    if (overlap.y > rect.y) out.push_back({ rect.x, rect.y, rect.width, overlap.y - rect.y });
+    if (overlap_bottom < bottom) out.push_back({ rect.x, overlap_bottom, rect.width, bottom - overlap_bottom });
+    if (overlap.x > rect.x) out.push_back({ rect.x, overlap.y, overlap.x - rect.x, overlap.height });
+    if (overlap_right < right) out.push_back({ overlap_right, overlap.y, right - overlap_right, overlap.height });
+}
+
+// Two disjoint rectangles whose union is a rectangle: same columns and
+// touching vertically, or same rows and touching horizontally
+static bool mergeable(const Rect& a, const Rect& b) {
+    if (a.x == b.x && a.width == b.width) return a.y + a.height == b.y || b.y + b.height == a.y;
+    if (a.y == b.y && a.height == b.height) return a.x + a.width == b.x || b.x + b.width == a.x;
+    return false;
+}
+
+void DamageRegion::add(const Rect& rect) {
+    if (rect.empty()) return;
+
+    for (const Rect& existing : rects_) {
+        if (existing.contains(rect)) return;
+    }
+
+    // Rectangles inside the new one are swallowed; of the new one only
+    // what no other rectangle covers is added, so the region stays
+    // disjoint
+    rects_.erase(std::remove_if(rects_.begin(), rects_.end(),
+                                [&](const Rect& existing) { return rect.contains(existing); }),
+                 rects_.end());
+    std::vector<Rect> pieces(1, rect), rest;
+    for (const Rect& existing : rects_) {
+        rest.clear();
+        for (const Rect& piece : pieces) subtract(piece, existing, rest);
+        pieces.swap(rest);
+    }
+
+    // Join each piece with the neighbours it forms a rectangle with;
+    // repeat until nothing changes
+    for (Rect merged : pieces) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t i = 0; i < rects_.size(); ++i) {
+                const Rect& existing = rects_[i];
+                if (!mergeable(existing, merged)) continue;
+
+                int right = std::max(existing.x + existing.width, merged.x + merged.width);
+                int bottom = std::max(existing.y + existing.height, merged.y + merged.height);
+                merged.x = std::min(existing.x, merged.x);
+                merged.y = std::min(existing.y, merged.y);
+                merged.width = right - merged.x;
+                merged.height = bottom - merged.y;
+                rects_.erase(rects_.begin() + i);
+                changed = true;
+                break;
+            }
+        }
+        rects_.push_back(merged);
+    }
+
+    if (rects_.size() > MAX_RECTS) {
+        Rect box = rects_[0];
+        for (const Rect& r : rects_) {
+            int right = std::max(box.x + box.width, r.x + r.width);
+            int bottom = std::max(box.y + box.height, r.y + r.height);
+            box.x = std::min(box.x, r.x);
+            box.y = std::min(box.y, r.y);
+            box.width = right - box.x;
+            box.height = bottom - box.y;
+        }
+        rects_.assign(1, box);
+    }
+}
+
+void DamageRegion::add(const DamageRegion& other) {
+    for (const Rect& rect : other.rects_) add(rect);
+}
+
+// Exact: the rectangles are disjoint
+int64_t DamageRegion::area() const {
+    int64_t total = 0;
+    for (const Rect& rect : rects_) total += rect.area();
+    return total;
+}
+
+void DamageTracker::reset(int width, int height) {
+    width_ = width;
+    height_ = height;
+    current_.clear();
+    for (auto& region : history_) region.clear();
+    frame_ = 0;
+    add_all();
+}
+
+void DamageTracker::add(const Rect& rect) {
+    current_.add(rect.intersected({ 0, 0, width_, height_ }));
+}
+
+DamageRegion DamageTracker::repaint(unsigned age) const {
+    DamageRegion region;
+    if (age == 0 || age > HISTORY || age > frame_ + 1) {
+        region.add({ 0, 0, width_, height_ });
+        return region;
+    }
+
+    region = current_;
+    for (unsigned i = 1; i < age; ++i) {
+        region.add(history_[(frame_ + 1 - i) % HISTORY]);
+    }
+    return region;
+}
+
+void DamageTracker::commit() {
+    ++frame_;
+    history_[frame_ % HISTORY] = current_;
+    current_.clear();
+}
+
+bool damage_self_test() {
+    const int size = 96;
+    uint32_t seed = 12345;
+    auto next = [&seed](int range) {
+        seed = seed * 1103515245u + 12345u;
+        return static_cast<int>((seed >> 16) % static_cast<uint32_t>(range));
+    };
+
+    std::vector<uint8_t> added(size * size), covered(size * size);
+    for (int round = 0; round < 200; ++round) {
+        DamageRegion region;
+        std::fill(added.begin(), added.end(), 0);
+
+        // Round 0: a bar on a rotated output, its old and new column side
+        // by side over the same rows, plus a band across both
+        std::vector<Rect> rects;
+        if (round == 0) {
+            rects = { { 10, 0, 8, size }, { 14, 0, 8, size }, { 0, 40, size, 8 } };
+        } else {
+            for (int i = 0, n = 2 + next(6); i < n; ++i) {
+                int x = next(size), y = next(size);
+                rects.push_back({ x, y, 1 + next(size - x), 1 + next(size - y) });
+            }
+        }
+        for (const Rect& rect : rects) {
+            region.add(rect);
+            for (int y = rect.y; y < rect.y + rect.height; ++y) {
+                std::fill(added.begin() + y * size + rect.x, added.begin() + y * size + rect.x + rect.width, 1);
+            }
+        }
+
+        std::fill(covered.begin(), covered.end(), 0);
+        for (const Rect& rect : region.rects()) {
+            for (int y = rect.y; y < rect.y + rect.height; ++y) {
+                for (int x = rect.x; x < rect.x + rect.width; ++x) {
+                    if (covered[y * size + x]++) return false;     // Overlap
+                }
+            }
+        }
+        // Collapsed into the bounding box it covers more, otherwise exactly
+        Rect box = rects[0];
+        for (const Rect& rect : rects) {
+            int right = std::max(box.x + box.width, rect.x + rect.width);
+            int bottom = std::max(box.y + box.height, rect.y + rect.height);
+            box.x = std::min(box.x, rect.x);
+            box.y = std::min(box.y, rect.y);
+            box.width = right - box.x;
+            box.height = bottom - box.y;
+        }
+        bool collapsed = region.rects().size() == 1 && region.rects()[0] == box;
+        for (int i = 0; i < size * size; ++i) {
+            if (added[i] && !covered[i]) return false;
+            if (!collapsed && covered[i] && !added[i]) return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Rectangle in buffer pixels
+struct Rect {
+    int x = 0, y = 0, width = 0, height = 0;
+
+    bool empty() const { return width <= 0 || height <= 0; }
+    bool contains(const Rect& other) const;
+    int64_t area() const { return empty() ? 0 : static_cast<int64_t>(width) * height; }
+    Rect intersected(const Rect& other) const;
+
+    bool operator==(const Rect& other) const {
+        return x == other.x && y == other.y && width == other.width && height == other.height;
+    }
+    bool operator!=(const Rect& other) const { return !(*this == other); }
+};
+
+// A handful of disjoint rectangles: every pixel of the region is in
+// exactly one of them, so each can be filled by its own tasks. What a new
+// rectangle overlaps is cut out of it, and rectangles that together form
+// one are merged; past MAX_RECTS the region collapses into its bounding
+// box, which keeps both the repaint loop and the number of damage
+// requests bounded.
+class DamageRegion {
+public:
+    static constexpr size_t MAX_RECTS = 16;
+
+    void add(const Rect& rect);
+    void add(const DamageRegion& other);
+    void clear() { rects_.clear(); }
+
+    bool empty() const { return rects_.empty(); }
+    int64_t area() const;
+    const std::vector<Rect>& rects() const { return rects_; }
+
+private:
+    std::vector<Rect> rects_;
+};
+
+// Adds overlapping rectangles, the way a frame's damage meets the buffer-age
+// history, and checks the region stays disjoint and covers exactly what was
+// added. Returns false on the first failure.
+bool damage_self_test();
+
+// Damage of the frame being built plus that of the last HISTORY frames.
+// A buffer whose contents are `age` frames old (EGL buffer-age semantics:
+// 1 means it holds the previous frame) only needs the union of the damage
+// of the frames it missed repainted.
+class DamageTracker {
+public:
+    static constexpr unsigned HISTORY = 8;
+
+    // New buffer size: nothing drawn so far can be reused
+    void reset(int width, int height);
+
+    // Content change in the frame being built, clipped to the buffer
+    void add(const Rect& rect);
+    void add_all() { add({ 0, 0, width_, height_ }); }
+
+    // What a buffer of this age must repaint. age 0 (contents undefined)
+    // or older than the history means everything.
+    DamageRegion repaint(unsigned age) const;
+
+    // Damage of the frame being built, as sent to the compositor
+    const DamageRegion& current() const { return current_; }
+
+    // The frame was committed: its damage moves into the history
+    void commit();
+
+    // Number of the frame being built, starting at 1
+    uint64_t frame() const { return frame_ + 1; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    int width_ = 0, height_ = 0;
+    DamageRegion current_;
+    DamageRegion history_[HISTORY];   // history_[frame % HISTORY] is that frame's damage
+    uint64_t frame_ = 0;              // Frames committed
+};
@@ -0,0 +1,110 @@
+#include "FrameStats.h"
+
+#include <iomanip>
+
+extern "C" {
+#include <presentation-time-client-protocol.h>
+}
+
+int Histogram::bucket_of(uint64_t value) {
+    if (value < 16) return static_cast<int>(value);
+    int log = 63 - __builtin_clzll(value);
+    int sub = static_cast<int>((value >> (log - 3)) & 7);
+    int bucket = 16 + (log - 4) * 8 + sub;
+    return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+uint64_t Histogram::bucket_value(int bucket) {
+    if (bucket < 16) return static_cast<uint64_t>(bucket);
+    int log = (bucket - 16) / 8 + 4;
+    uint64_t sub = static_cast<uint64_t>((bucket - 16) % 8);
+    // Middle of the bucket's range halves the worst-case error
+    return ((8 + sub) << (log - 3)) + ((1ull << (log - 3)) >> 1);
+}
+
+void Histogram::record(uint64_t value) {
+    buckets_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t current = max_.load(std::memory_order_relaxed);
+    while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void Histogram::reset() {
+    for (auto& bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+double Histogram::mean() const {
+    uint64_t n = count();
+    return n ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+uint64_t Histogram::percentile(double p) const {
+    uint64_t n = count();
+    if (n == 0) return 0;
+
+    uint64_t target = static_cast<uint64_t>(p / 100.0 * n);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen > target) return bucket_value(i);
+    }
+    return max();
+}
+
+void PresentationStats::record_presented(uint64_t latency_ns, uint32_t refresh_ns, uint32_t flags) {
+    presented.fetch_add(1, std::memory_order_relaxed);
+    latency_us.record(latency_ns / 1000);
+    if (refresh_ns) refresh_us.record(refresh_ns / 1000);
+
+    if (flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC) vsync.fetch_add(1, std::memory_order_relaxed);
+    if (flags & WP_PRESENTATION_FEEDBACK_KIND_HW_CLOCK) hw_clock.fetch_add(1, std::memory_order_relaxed);
+    if (flags & WP_PRESENTATION_FEEDBACK_KIND_HW_COMPLETION) hw_completion.fetch_add(1, std::memory_order_relaxed);
+    if (flags & WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY) zero_copy.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PresentationStats::record_discarded() {
+    discarded.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PresentationStats::record_unmeasured() {
+    unmeasured.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PresentationStats::dump(std::ostream& out, const char* label) const {
+    uint64_t shown = presented.load(std::memory_order_relaxed);
+    auto percent = [shown](const std::atomic<uint64_t>& n) {
+        return shown ? 100.0 * n.load(std::memory_order_relaxed) / shown : 0.0;
+    };
+
+    out << std::fixed << std::setprecision(1);
+    out << "🖥️  " << label << ": presented " << shown << ", discarded " << discarded.load(std::memory_order_relaxed)
+        << " | vsync " << percent(vsync) << "%, zero-copy " << percent(zero_copy)
+        << "%, hw-clock " << percent(hw_clock) << "%, hw-completion " << percent(hw_completion) << "%\n";
+
+    // The histograms below only cover the commits that got feedback
+    uint64_t missed = unmeasured.load(std::memory_order_relaxed);
+    if (missed) {
+        uint64_t commits = shown + discarded.load(std::memory_order_relaxed) + missed;
+        out << "    unmeasured " << missed << " commits (" << 100.0 * missed / commits
+            << "%): every feedback slot was still in flight\n";
+    }
+
+    if (latency_us.count()) {
+        out << "    latency  p50 " << latency_us.percentile(50) / 1000.0 << " ms, p90 "
+            << latency_us.percentile(90) / 1000.0 << " ms, p99 " << latency_us.percentile(99) / 1000.0
+            << " ms, max " << latency_us.max() / 1000.0 << " ms\n";
+    }
+    if (refresh_us.count()) {
+        // The interval is normally constant, so the exact mean beats a bucket bound
+        double refresh = refresh_us.mean();
+        out << "    refresh  mean " << std::setprecision(3) << refresh / 1000.0 << " ms ("
+            << (refresh > 0 ? 1e6 / refresh : 0.0) << " Hz), max " << refresh_us.max() / 1000.0 << " ms\n";
+    }
+    out << std::defaultfloat;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Log-linear histogram (8 sub-buckets per power of two, ~12% resolution)
+// whose counters are relaxed atomics, so any thread may record into it or
+// dump it without taking a lock.
+class Histogram {
+public:
+    static constexpr int BUCKETS = 16 + 60 * 8;
+
+    void record(uint64_t value);
+    void reset();
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    double mean() const;
+    uint64_t percentile(double p) const;
+
+private:
+    static int bucket_of(uint64_t value);
+    static uint64_t bucket_value(int bucket);
+
+    std::atomic<uint64_t> buckets_[BUCKETS] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// wp_presentation feedback collected for one output
+struct PresentationStats {
+    Histogram latency_us;       // wl_surface.commit to presented timestamp
+    Histogram refresh_us;       // Refresh interval reported by the compositor
+    std::atomic<uint64_t> presented{0};
+    std::atomic<uint64_t> discarded{0};
+    std::atomic<uint64_t> unmeasured{0};     // Commits sent without feedback, every slot in flight
+    std::atomic<uint64_t> vsync{0};
+    std::atomic<uint64_t> hw_clock{0};
+    std::atomic<uint64_t> hw_completion{0};
+    std::atomic<uint64_t> zero_copy{0};
+
+    // flags is the wp_presentation_feedback.presented kind bitmask
+    void record_presented(uint64_t latency_ns, uint32_t refresh_ns, uint32_t flags);
+    void record_discarded();
+    void record_unmeasured();
+
+    void dump(std::ostream& out, const char* label) const;
+};
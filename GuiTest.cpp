@@ -5,25 +5,81 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <iomanip>
+#include <thread>
+#include <sys/eventfd.h>
+
+#include "ShmPool.h"
+#include "PixelFill.h"
+#include "PixelFormat.h"
+#include "RenderPool.h"
+#include "TimerQueue.h"
+#include "FrameStats.h"
+#include "BufferCache.h"
+#include "Damage.h"
+#include "TileHash.h"
+#include "RenderScale.h"
+#include "Log.h"
+#include "ProtocolStats.h"
+#include "Trace.h"
+#include "PerfCounters.h"
 
 extern "C" {
 #include <wayland-client.h>
 #include <xdg-shell-client-protocol.h>
+#include <viewporter-client-protocol.h>
+#include <single-pixel-buffer-v1-client-protocol.h>
+#include <presentation-time-client-protocol.h>
+#include <fractional-scale-v1-client-protocol.h>
+#include <xdg-output-unstable-v1-client-protocol.h>
 }
 
-#define BUFFER_FORMAT WL_SHM_FORMAT_XRGB8888
-#define PIXEL_SIZE 4
+#define COLOR_INTERVAL_MS 3000
 
-// Color palette (RGB in XRGB8888)
-const uint32_t COLORS[][2] = {
-    {0x00FF0000, 0x000000FF}, // Red, Blue
-    {0x0000FF00, 0x00FFFF00}, // Green, Yellow
-    {0x00800080, 0x0000FFFF}, // Purple, Cyan
-    {0x00FF00FF, 0x00FFA500}, // Magenta, Orange
+// Height and sweep period of the bar drawn in --animate mode
+#define ANIMATION_BAR_HEIGHT 64
+#define ANIMATION_PERIOD_MS 2000
+
+// wp_presentation_feedback objects a window may have in flight
+#define MAX_PENDING_FEEDBACK 8
+
+// Default budget of all windows together for pre-rendered palette buffers
+// (--cache-mb)
+#define PALETTE_CACHE_BUDGET_MB 512
+
+// --dynamic-scale: share of the refresh interval a frame may take to render
+#define RENDER_BUDGET_PERCENT 75
+
+// Color palette (RGB in XRGB8888). At color step k window i shows entry
+// (2k + i) % NUM_COLORS, so the first two windows keep the original
+// Red/Blue, Green/Yellow, ... pairs and neighbouring panels always differ.
+struct PaletteColor {
+    uint32_t value;
+    const char* name;
+};
+
+const PaletteColor COLORS[] = {
+    {0x00FF0000, "Red"},     {0x000000FF, "Blue"},
+    {0x0000FF00, "Green"},   {0x00FFFF00, "Yellow"},
+    {0x00800080, "Purple"},  {0x0000FFFF, "Cyan"},
+    {0x00FF00FF, "Magenta"}, {0x00FFA500, "Orange"},
 };
 
 const int NUM_COLORS = sizeof(COLORS) / sizeof(COLORS[0]);
 
+static const PaletteColor& window_color(int step, int index) {
+    return COLORS[(2 * step + index) % NUM_COLORS];
+}
+
+// --bench-outputs: window counts the scaling benchmark walks through
+#define BENCH_MAX_OUTPUTS 16
+
 class WaylandWindow {
 private:
     struct wl_display* display;
@@ -31,61 +87,313 @@ private:
     struct wl_compositor* compositor;
     struct xdg_wm_base* wm_base;
     struct wl_shm* shm;
+    struct wp_viewporter* viewporter;
+    struct wp_single_pixel_buffer_manager_v1* single_pixel_manager;
+    struct wp_presentation* presentation;
+    struct wp_fractional_scale_manager_v1* fractional_scale_manager = nullptr;
+    struct zxdg_output_manager_v1* xdg_output_manager = nullptr;
+    clockid_t presentation_clock = CLOCK_MONOTONIC;
+    uint32_t compositor_version = 1;
+    uint32_t wm_base_version = 1;
+
+    struct Window;
+
+    // Output properties. Events fill Output::pending; wl_output.done (or
+    // zxdg_output_v1.done before v3) commits it to Output::current at once.
+    struct OutputState {
+        int mode_width = 0, mode_height = 0;     // Current mode, in pixels
+        int refresh_mhz = 0;
+        int32_t transform = WL_OUTPUT_TRANSFORM_NORMAL;
+        int32_t scale = 1;
+        int logical_width = 0, logical_height = 0;   // From zxdg_output_v1, 0 if unknown
+    };
 
-    struct {
-        struct wl_surface* surface;
-        struct xdg_surface* xdg_surface;
-        struct xdg_toplevel* xdg_toplevel;
-        struct wl_buffer* buffer;
-        struct wl_output* output;
-        void* shm_data;
-        int width, height;           // ← Now tracked per window
-        uint32_t color;
-        bool configured = false;
-        bool toplevel_configured = false;
-        char title[64];
-    } windows[2];
-
-    bool running = true;
-    std::vector<struct wl_output*> outputs;
-    std::vector<std::string> output_names;
-    std::vector<int> output_widths;   // ← Store resolutions
-    std::vector<int> output_heights;  // ← Store resolutions
-
-    int current_color_index = 0;
+    // One bound wl_output; the record is its listener data
+    struct Output {
+        WaylandWindow* owner = nullptr;
+        struct wl_output* output = nullptr;
+        struct zxdg_output_v1* xdg_output = nullptr;
+        uint32_t global_name = 0;       // Registry name, matched in global_remove
+        std::string name = "Unknown";
+        OutputState pending, current;
+        Window* window = nullptr;
+    };
+
+    // One in-flight presentation feedback and the time of its commit
+    struct Feedback {
+        Window* win = nullptr;
+        struct wp_presentation_feedback* feedback = nullptr;
+        uint64_t commit_ns = 0;
+    };
+
+    // One fullscreen window per output. Held by pointer because listeners
+    // and feedback slots keep its address.
+    struct Window {
+        struct wl_surface* surface = nullptr;
+        struct xdg_surface* xdg_surface = nullptr;
+        struct xdg_toplevel* xdg_toplevel = nullptr;
+        struct wl_buffer* buffer = nullptr;    // Currently attached slot of pool
+        Output* output = nullptr;
+        void* shm_data = nullptr;
+        ShmPool pool;
+        BufferCache cache;           // Rendered palette colors, static content only
+        std::vector<uint32_t> palette;                // Colors the window cycles through
+        std::vector<BufferCache::Entry*> cache_fills; // Entries to render this frame
+        struct wp_viewport* viewport = nullptr;
+        struct wp_fractional_scale_v1* fractional_scale = nullptr;
+        bool solid = false;          // Solid-color fast path: 1x1 buffer scaled by the viewport
+        std::vector<std::pair<uint32_t, struct wl_buffer*>> solid_buffers;  // 1x1 buffer per color
+        int surface_width = 800, surface_height = 600;   // Logical size from configure
+        int width = 800, height = 600;           // Buffer size in pixels
+
+        // Scale the buffer is drawn at: the output's integer scale, or the
+        // fractional one the compositor prefers for this surface
+        std::atomic<int> output_scale{1};    // Published by the main thread on wl_output.done
+        int32_t buffer_scale = 1;
+        uint32_t scale_120 = 0;              // wp_fractional_scale_v1 numerator, 0 if none
+        bool scale_dirty = true;             // Scale state not yet sent to the compositor
+        int32_t sent_buffer_scale = 1;       // Last wl_surface.set_buffer_scale
+
+        // Content is drawn pre-rotated for the output transform, so the
+        // buffer has the output mode's orientation and can be scanned out
+        std::atomic<int> output_transform{WL_OUTPUT_TRANSFORM_NORMAL};   // Published like output_scale
+        std::atomic<uint64_t> output_mode{0};   // Mode width << 32 | height, 0 if unknown
+        int32_t buffer_transform = WL_OUTPUT_TRANSFORM_NORMAL;
+        int32_t sent_buffer_transform = WL_OUTPUT_TRANSFORM_NORMAL;
+        std::atomic<int> zero_copy{-1};      // Last presentation was zero-copy, -1 before the first
+        RenderScale render_scale;            // --dynamic-scale: share of those pixels drawn
+        uint32_t color = 0;
+        bool configured = false;     // First xdg_surface.configure acked
+
+        // xdg_toplevel.configure is double-buffered: collected here, applied
+        // by the xdg_surface.configure that ends the sequence
+        struct {
+            int width = 0, height = 0;   // 0: size left to the client
+            int bounds_width = 0, bounds_height = 0;   // configure_bounds, 0: unbounded
+            bool suspended = false;
+        } pending_configure;
+
+        // Suspended (xdg_toplevel v6, e.g. fully hidden or the screen
+        // locked): nothing is drawn or committed until it is shown again.
+        // Written by the thread dispatching the window, read by the main
+        // thread to pause the color timer.
+        std::atomic<bool> suspended{false};
+        uint64_t suspended_since = 0;
+        std::atomic<uint64_t> suspensions{0};
+        std::atomic<uint64_t> suspended_ns{0};
+        std::atomic<uint64_t> configures{0};
+        std::atomic<uint64_t> reallocations{0};          // Buffer size changed
+        std::atomic<uint64_t> reallocations_avoided{0};  // Same size: acked, buffers and frame kept
+        char title[64] = {};
+
+        // Frame pacing: a new frame is only drawn once the compositor has
+        // signalled (via frame_callback) that the previous one was shown
+        WaylandWindow* owner = nullptr;
+        int index = 0;
+        struct wl_callback* frame_callback = nullptr;
+        bool needs_redraw = false;
+        uint32_t frame_time = 0;     // Timestamp of the last frame callback (ms)
+        Rect bar;                    // Animated bar in buffer pixels, empty when not animating
+
+        // Damage: what changed since the previous frame, and how much of
+        // each buffer had to be repainted to catch up with it
+        DamageTracker damage;
+        DamageRegion repaint;        // Pixels being filled this frame
+        // Columns [x0, x1) of one repaint rect, the context of its fill
+        // tasks: rects sharing rows never write the same pixels
+        struct FillSpan {
+            Window* win;
+            int x0, x1;
+        };
+        std::vector<FillSpan> fill_spans;
+        uint32_t drawn_color = 0;
+        Rect drawn_bar;
+        std::atomic<uint64_t> repaint_pixels{0};
+        std::atomic<uint64_t> frame_pixels{0};
+
+        // --tile-damage: damage found by hashing tile rows as they are drawn
+        TileHasher tiles;
+        DamageRegion changed_tiles;
+        std::atomic<uint64_t> hash_ns{0};
+        std::atomic<uint64_t> tiles_hashed{0};
+        std::atomic<uint64_t> tiles_changed{0};
+        std::atomic<int> refresh_mhz{0};     // Of the assigned output, published like output_scale
+        std::atomic<uint64_t> frames{0};
+        int color_index = -1;        // Color step currently drawn
+
+        // --threaded: this window's objects live on their own event queue,
+        // dispatched and rendered by their own thread
+        std::thread thread;
+        std::atomic<bool> closing{false};   // Output unplugged: the thread exits
+        struct wl_event_queue* queue = nullptr;
+        int wake_fd = -1;            // eventfd the main thread pokes on color changes
+        struct wl_shm* shm = nullptr;                 // Global, or a wrapper on queue
+        struct wp_presentation* presentation = nullptr;
+        std::vector<RenderTask> render_tasks;
+
+        Feedback feedbacks[MAX_PENDING_FEEDBACK];
+        PresentationStats presentation_stats;
+        Histogram draw_us;           // Buffer selection, fill and commit of one frame
+        ProtocolStats protocol;      // Requests its frames cost, events sent to its objects
+        ProtocolStats* event_stats = nullptr;   // &protocol unless its queue counts them (--threaded)
+        PerfStats fill_perf;         // --perf-counters: the fill kernel, all threads
+        PerfStats hash_perf;         // ... and tile hashing
+    };
+    std::vector<std::unique_ptr<Window>> windows;
+
+    RenderPool render_pool;
+    std::vector<RenderTask> render_tasks;   // Reused every frame
+
+    // Protocol traffic outside the windows' frames (PROTOCOL_STATS builds)
+    ProtocolStats startup_protocol;
+    ProtocolStats loop_protocol;
+    uint64_t loop_ticks = 0;
+
+    TimerQueue timers;
+    int color_timer = -1;
+    bool color_timer_paused = false;
+    uint64_t last_color_tick = 0;
+
+    // SIGUSR1 writes to this pipe so the event loop dumps statistics
+    static int stats_pipe[2];
+
+    std::atomic<bool> running{true};
+    bool started = false;             // Initial windows exist; later outputs are hotplugged
+    int next_window_index = 0;
+    bool animate = false;
+    bool tile_damage = false;
+    bool dynamic_scale = false;
+    uint64_t frame_budget_us = 0;     // 0: RENDER_BUDGET_PERCENT of the output's refresh interval
+    bool threaded = false;
+    CacheBudget cache_budget{static_cast<size_t>(PALETTE_CACHE_BUDGET_MB) << 20};   // All windows' palettes
+
+    // Buffer format and the fill kernels instantiated for it. Negotiated from
+    // the wl_shm.format events unless forced with --format.
+    const PixelFormatInfo* format = &pixel_format_info(PixelFormat::XRGB8888);
+    void (*fill_kernel)(void*, size_t, size_t) = fill_rows<FormatXRGB8888>;
+    void (*palette_kernel)(void*, size_t, size_t) = fill_palette_rows<FormatXRGB8888>;
+    bool format_forced = false;
+    uint32_t shm_formats = 0;         // pixel_format_bit() mask of the advertised formats
+    int wake_fd = -1;                 // Wakes the main loop when a window thread stops
+    std::vector<std::unique_ptr<Output>> outputs;
+
+    std::atomic<int> current_color_index{0};
 
     // Output listener callbacks
     static void output_geometry(void* data, struct wl_output* wl_output,
                                 int32_t x, int32_t y, int32_t physical_width,
                                 int32_t physical_height, int32_t subpixel,
                                 const char* make, const char* model,
-                                int32_t transform) {}
+                                int32_t transform) {
+        Output* out = static_cast<Output*>(data);
+        out->pending.transform = transform;
+    }
 
 	static void output_mode(void *data, struct wl_output *wl_output,
 							uint32_t flags, int32_t width, int32_t height,
 							int32_t refresh)
 	{
-		WaylandWindow *self = static_cast<WaylandWindow *>(data);
+		Output *out = static_cast<Output *>(data);
 
-		for (size_t i = 0; i < self->outputs.size(); ++i)
+		// Other modes are only advertised, the output is not running them
+		if (flags & WL_OUTPUT_MODE_CURRENT)
 		{
-			if (self->outputs[i] == wl_output)
-			{
-				// Only update if this mode is larger than current
-				if (width * height > self->output_widths[i] * self->output_heights[i])
-				{
-					self->output_widths[i] = width;
-					self->output_heights[i] = height;
-				}
-				return;
-			}
+			out->pending.mode_width = width;
+			out->pending.mode_height = height;
+			out->pending.refresh_mhz = refresh;
 		}
 	}
 
-    static void output_done(void* data, struct wl_output* wl_output) {}
+    static void output_done(void* data, struct wl_output* wl_output) {
+        Output* out = static_cast<Output*>(data);
+        out->owner->commit_output(*out);
+    }
 
     static void output_scale(void* data, struct wl_output* wl_output,
-                             int32_t factor) {}
+                             int32_t factor) {
+        Output* out = static_cast<Output*>(data);
+        out->pending.scale = factor > 0 ? factor : 1;
+    }
+
+    // zxdg_output_v1: logical size and a real name for the output
+    static void xdg_output_logical_position(void* data, struct zxdg_output_v1* xdg_output,
+                                            int32_t x, int32_t y) {}
+
+    static void xdg_output_logical_size(void* data, struct zxdg_output_v1* xdg_output,
+                                        int32_t width, int32_t height) {
+        Output* out = static_cast<Output*>(data);
+        out->pending.logical_width = width;
+        out->pending.logical_height = height;
+    }
+
+    // Only sent before v3; from v3 on wl_output.done covers xdg_output too
+    static void xdg_output_done(void* data, struct zxdg_output_v1* xdg_output) {
+        Output* out = static_cast<Output*>(data);
+        out->owner->commit_output(*out);
+    }
+
+    static void xdg_output_name(void* data, struct zxdg_output_v1* xdg_output, const char* name) {
+        Output* out = static_cast<Output*>(data);
+        out->name = name;
+    }
+
+    static void xdg_output_description(void* data, struct zxdg_output_v1* xdg_output,
+                                       const char* description) {}
+
+    // Apply the pending output state in one step. A hotplugged output gets
+    // its window here, once its mode is known; an existing window picks up
+    // the new scale on its own thread.
+    void commit_output(Output& out) {
+        out.current = out.pending;
+
+        if (out.window) {
+            out.window->refresh_mhz.store(out.current.refresh_mhz, std::memory_order_relaxed);
+            out.window->output_scale.store(out.current.scale, std::memory_order_relaxed);
+            out.window->output_transform.store(out.current.transform, std::memory_order_relaxed);
+            out.window->output_mode.store(mode_key(out.current), std::memory_order_relaxed);
+            wake(out.window->wake_fd);
+            return;
+        }
+        if (!started) return;
+
+        LOG_INFO << "🔌 Output " << out.name << " connected (" << out.current.mode_width << "x"
+                 << out.current.mode_height << ")";
+        if (!open_window(out)) return;
+        sync_color(*out.window);
+        wl_surface_commit(out.window->surface);
+        protocol_request();
+        if (threaded) start_thread(*out.window);
+    }
+
+    static uint64_t mode_key(const OutputState& state) {
+        return static_cast<uint64_t>(state.mode_width) << 32 | static_cast<uint32_t>(state.mode_height);
+    }
+
+    // Logical (surface coordinate) size of an output: zxdg_output_v1 when
+    // known, else the current mode rotated by the transform and divided by
+    // the integer scale
+    static void logical_size(const OutputState& state, int& width, int& height) {
+        if (state.logical_width > 0 && state.logical_height > 0) {
+            width = state.logical_width;
+            height = state.logical_height;
+            return;
+        }
+        width = state.mode_width > 0 ? state.mode_width : 1920;
+        height = state.mode_height > 0 ? state.mode_height : 1080;
+        if (state.transform & 1) std::swap(width, height);   // 90 and 270 degree transforms
+        width /= state.scale;
+        height /= state.scale;
+    }
+
+    static void fractional_preferred_scale(void* data, struct wp_fractional_scale_v1* fractional_scale,
+                                           uint32_t scale) {
+        Window* win = static_cast<Window*>(data);
+        protocol_event(win->event_stats);
+        win->scale_120 = scale;
+        win->scale_dirty = true;
+        win->needs_redraw = true;
+        win->owner->update_buffer_size(*win);
+    }
 
     // Registry global handler
     static void registry_global(void* data, struct wl_registry* registry,
@@ -93,298 +401,1521 @@ private:
         WaylandWindow* self = static_cast<WaylandWindow*>(data);
 
         if (std::strcmp(interface, wl_compositor_interface.name) == 0) {
+            // v3 for wl_surface.set_buffer_scale, v4 for wl_surface.damage_buffer
+            self->compositor_version = std::min(version, 4u);
             self->compositor = static_cast<wl_compositor*>(
-                wl_registry_bind(registry, name, &wl_compositor_interface, 1));
+                wl_registry_bind(registry, name, &wl_compositor_interface, self->compositor_version));
+            protocol_request();
         } else if (std::strcmp(interface, xdg_wm_base_interface.name) == 0) {
+            // v4 configure_bounds, v5 wm_capabilities, v6 the suspended state
+            self->wm_base_version = std::min(version, 6u);
             self->wm_base = static_cast<xdg_wm_base*>(
-                wl_registry_bind(registry, name, &xdg_wm_base_interface, 1));
+                wl_registry_bind(registry, name, &xdg_wm_base_interface, self->wm_base_version));
+            protocol_request();
             xdg_wm_base_add_listener(self->wm_base, &self->wm_base_listener_impl, self);
         } else if (std::strcmp(interface, wl_shm_interface.name) == 0) {
             self->shm = static_cast<wl_shm*>(
                 wl_registry_bind(registry, name, &wl_shm_interface, 1));
+            protocol_request();
+            wl_shm_add_listener(self->shm, &self->shm_listener_impl, self);
+        } else if (std::strcmp(interface, wp_viewporter_interface.name) == 0) {
+            self->viewporter = static_cast<wp_viewporter*>(
+                wl_registry_bind(registry, name, &wp_viewporter_interface, 1));
+            protocol_request();
+        } else if (std::strcmp(interface, wp_single_pixel_buffer_manager_v1_interface.name) == 0) {
+            self->single_pixel_manager = static_cast<wp_single_pixel_buffer_manager_v1*>(
+                wl_registry_bind(registry, name, &wp_single_pixel_buffer_manager_v1_interface, 1));
+            protocol_request();
+        } else if (std::strcmp(interface, wp_presentation_interface.name) == 0) {
+            self->presentation = static_cast<wp_presentation*>(
+                wl_registry_bind(registry, name, &wp_presentation_interface, 1));
+            protocol_request();
+            wp_presentation_add_listener(self->presentation, &presentation_listener_impl, self);
         } else if (std::strcmp(interface, wl_output_interface.name) == 0) {
-            struct wl_output* output = static_cast<wl_output*>(
+            auto out = std::make_unique<Output>();
+            out->owner = self;
+            out->global_name = name;
+            out->output = static_cast<wl_output*>(
                 wl_registry_bind(registry, name, &wl_output_interface, 2)); // v2 for scale/name
-            wl_output_add_listener(output, &self->output_listener_impl, self);
-            self->outputs.push_back(output);
-            self->output_names.push_back("Unknown");
-            self->output_widths.push_back(0);   // Initialize resolution trackers
-            self->output_heights.push_back(0);
+            protocol_request();
+            wl_output_add_listener(out->output, &self->output_listener_impl, out.get());
+            if (self->xdg_output_manager) self->bind_xdg_output(*out);
+            self->outputs.push_back(std::move(out));
+        } else if (std::strcmp(interface, wp_fractional_scale_manager_v1_interface.name) == 0) {
+            self->fractional_scale_manager = static_cast<wp_fractional_scale_manager_v1*>(
+                wl_registry_bind(registry, name, &wp_fractional_scale_manager_v1_interface, 1));
+            protocol_request();
+        } else if (std::strcmp(interface, zxdg_output_manager_v1_interface.name) == 0) {
+            self->xdg_output_manager = static_cast<zxdg_output_manager_v1*>(
+                wl_registry_bind(registry, name, &zxdg_output_manager_v1_interface, std::min(version, 3u)));
+            protocol_request();
+            for (auto& out : self->outputs) self->bind_xdg_output(*out);
+        }
+    }
+
+    void bind_xdg_output(Output& out) {
+        out.xdg_output = zxdg_output_manager_v1_get_xdg_output(xdg_output_manager, out.output);
+        protocol_request();
+        zxdg_output_v1_add_listener(out.xdg_output, &xdg_output_listener_impl, &out);
+    }
+
+    // Sent once per supported format right after binding
+    static void shm_format(void* data, struct wl_shm* shm, uint32_t format) {
+        WaylandWindow* self = static_cast<WaylandWindow*>(data);
+        self->shm_formats |= pixel_format_bit(format);
+    }
+
+    // Unplugged output: drop its window and SHM memory right away. Only the
+    // outputs are hotplug-capable here; other globals are not expected to go.
+    static void registry_global_remove(void* data, struct wl_registry* registry, uint32_t name) {
+        WaylandWindow* self = static_cast<WaylandWindow*>(data);
+
+        for (auto it = self->outputs.begin(); it != self->outputs.end(); ++it) {
+            Output& out = **it;
+            if (out.global_name != name) continue;
+
+            LOG_INFO << "🔌 Output " << out.name << " disconnected";
+            if (out.window) self->close_window(*out.window);
+            if (out.xdg_output) {
+                zxdg_output_v1_destroy(out.xdg_output);
+                protocol_request();
+            }
+            wl_output_destroy(out.output);
+            self->outputs.erase(it);
+            return;
         }
     }
 
-    static void registry_global_remove(void* data, struct wl_registry* registry, uint32_t name) {}
+    // Presentation clock domain, sent once after binding wp_presentation
+    static void presentation_clock_id(void* data, struct wp_presentation* presentation, uint32_t clk_id) {
+        WaylandWindow* self = static_cast<WaylandWindow*>(data);
+        self->presentation_clock = static_cast<clockid_t>(clk_id);
+    }
+
+    static void feedback_sync_output(void* data, struct wp_presentation_feedback* feedback,
+                                     struct wl_output* output) {
+        protocol_event(static_cast<Feedback*>(data)->win->event_stats);
+    }
+
+    static void feedback_presented(void* data, struct wp_presentation_feedback* feedback,
+                                   uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+                                   uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo, uint32_t flags) {
+        Feedback* slot = static_cast<Feedback*>(data);
+        protocol_event(slot->win->event_stats);
+        uint64_t presented_ns = ((static_cast<uint64_t>(tv_sec_hi) << 32 | tv_sec_lo) * 1000000000ull) + tv_nsec;
+        uint64_t latency = presented_ns > slot->commit_ns ? presented_ns - slot->commit_ns : 0;
+
+        slot->win->presentation_stats.record_presented(latency, refresh, flags);
+        if (slot->win->owner->presentation_clock == CLOCK_MONOTONIC) {
+            trace_track("presented", slot->commit_ns, presented_ns, slot->win->index);
+        }
+
+        int zero_copy = (flags & WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY) ? 1 : 0;
+        if (slot->win->zero_copy.exchange(zero_copy, std::memory_order_relaxed) != zero_copy) {
+            LOG_INFO << (zero_copy ? "🚀 Window " : "🧩 Window ") << slot->win->index+1
+                     << (zero_copy ? ": zero-copy scanout" : ": composited, not zero-copy");
+        }
+        wp_presentation_feedback_destroy(feedback);
+        slot->feedback = nullptr;
+    }
+
+    static void feedback_discarded(void* data, struct wp_presentation_feedback* feedback) {
+        Feedback* slot = static_cast<Feedback*>(data);
+        protocol_event(slot->win->event_stats);
+        slot->win->presentation_stats.record_discarded();
+        trace_instant("discarded", slot->win->index);
+        wp_presentation_feedback_destroy(feedback);
+        slot->feedback = nullptr;
+    }
+
+    static void stats_signal(int) {
+        char byte = 0;
+        ssize_t ignored = write(stats_pipe[1], &byte, 1);
+        (void)ignored;
+    }
 
     // xdg_wm_base ping
     static void xdg_wm_base_ping(void* data, struct xdg_wm_base* wm_base, uint32_t serial) {
         xdg_wm_base_pong(wm_base, serial);
+        protocol_request();
     }
 
-    // Generic configure callback
+    // End of a configure sequence: ack it and apply the pending toplevel
+    // state. Only a changed buffer size costs a new allocation and frame;
+    // anything else is acknowledged by a bare commit.
     static void xdg_surface_configure(void* data, struct xdg_surface* surface,
                                       uint32_t serial) {
-        WaylandWindow* self = static_cast<WaylandWindow*>(data);
-
-        for (int i = 0; i < 2; ++i) {
-            if (self->windows[i].xdg_surface == surface) {
-                xdg_surface_ack_configure(surface, serial);
-                self->windows[i].configured = true;
-
-                if (self->windows[i].configured && self->windows[i].toplevel_configured) {
-                    self->create_buffer(i);
-                    xdg_toplevel_set_fullscreen(self->windows[i].xdg_toplevel, self->windows[i].output);
-                    wl_surface_commit(self->windows[i].surface);
-                }
-                return;
-            }
+        Window* win = static_cast<Window*>(data);
+        protocol_event(win->event_stats);
+
+        xdg_surface_ack_configure(surface, serial);
+        protocol_request();
+        win->configures++;
+
+        const auto& pending = win->pending_configure;
+        if (pending.width > 0) win->surface_width = pending.width;
+        else if (pending.bounds_width > 0) win->surface_width = std::min(win->surface_width, pending.bounds_width);
+        if (pending.height > 0) win->surface_height = pending.height;
+        else if (pending.bounds_height > 0) win->surface_height = std::min(win->surface_height, pending.bounds_height);
+        win->owner->set_suspended(*win, pending.suspended);
+        bool resized = win->owner->update_buffer_size(*win);
+        if (resized || !win->configured) check_scanout_size(*win);
+
+        if (!win->configured) {
+            // First configure: the render loop draws the first frame
+            win->configured = true;
+            win->needs_redraw = true;
+        } else if (resized) {
+            win->reallocations++;
+        } else {
+            win->reallocations_avoided++;
+            wl_surface_commit(win->surface);
+            protocol_request();
         }
     }
 
-    // Generic toplevel configure callback
+    // Direct scanout needs the buffer to cover the output mode pixel for
+    // pixel; say so when the configured size does not
+    static void check_scanout_size(Window& win) {
+        uint64_t mode = win.output_mode.load(std::memory_order_relaxed);
+        int mode_width = static_cast<int>(mode >> 32), mode_height = static_cast<int>(mode & 0xFFFFFFFF);
+        if (!mode_width || !mode_height || (win.width == mode_width && win.height == mode_height)) return;
+        LOG_INFO << "ℹ️  Window " << win.index+1 << ": buffer " << win.width << "x" << win.height
+                 << " differs from the " << mode_width << "x" << mode_height
+                 << " mode, the compositor has to scale it (no direct scanout)";
+    }
+
     static void xdg_toplevel_configure(void* data, struct xdg_toplevel* toplevel,
                                        int32_t width, int32_t height, struct wl_array* states) {
-        WaylandWindow* self = static_cast<WaylandWindow*>(data);
+        Window* win = static_cast<Window*>(data);
+        protocol_event(win->event_stats);
+        win->pending_configure.width = width;
+        win->pending_configure.height = height;
+
+        win->pending_configure.suspended = false;
+        const uint32_t* state = static_cast<const uint32_t*>(states->data);
+        for (size_t i = 0; i < states->size / sizeof(uint32_t); ++i) {
+            if (state[i] == XDG_TOPLEVEL_STATE_SUSPENDED) win->pending_configure.suspended = true;
+        }
+    }
 
-        for (int i = 0; i < 2; ++i) {
-            if (self->windows[i].xdg_toplevel == toplevel) {
-                self->windows[i].width = width > 0 ? width : self->windows[i].width;
-                self->windows[i].height = height > 0 ? height : self->windows[i].height;
-                self->windows[i].toplevel_configured = true;
+    // Maximum size worth using; only applied when configure leaves the size to us
+    static void xdg_toplevel_configure_bounds(void* data, struct xdg_toplevel* toplevel,
+                                              int32_t width, int32_t height) {
+        Window* win = static_cast<Window*>(data);
+        protocol_event(win->event_stats);
+        win->pending_configure.bounds_width = width;
+        win->pending_configure.bounds_height = height;
+    }
 
-                if (self->windows[i].configured && self->windows[i].toplevel_configured) {
-                    self->create_buffer(i);
-                    xdg_toplevel_set_fullscreen(self->windows[i].xdg_toplevel, self->windows[i].output);
-                    wl_surface_commit(self->windows[i].surface);
-                }
-                return;
-            }
+    // No window menu, minimize or maximize controls to show or hide
+    static void xdg_toplevel_wm_capabilities(void* data, struct xdg_toplevel* toplevel,
+                                             struct wl_array* capabilities) {
+        protocol_event(static_cast<Window*>(data)->event_stats);
+    }
+
+    // Entering suspension stops drawing; leaving it schedules one frame,
+    // which picks up the current color, size and animation phase at once
+    void set_suspended(Window& win, bool suspended) {
+        if (suspended == win.suspended.load(std::memory_order_relaxed)) return;
+        win.suspended.store(suspended, std::memory_order_relaxed);
+
+        uint64_t now = TimerQueue::now_ns();
+        if (suspended) {
+            win.suspended_since = now;
+            win.suspensions++;
+            LOG_INFO << "💤 Window " << win.index+1 << " suspended, rendering paused";
+        } else {
+            win.suspended_ns += now - win.suspended_since;
+            win.frame_time = static_cast<uint32_t>(now / 1000000);   // Frame callback clock
+            win.needs_redraw = true;
+            LOG_INFO << "👁️  Window " << win.index+1 << " shown again after "
+                     << (now - win.suspended_since) / 1000000 << " ms";
         }
+        wake(wake_fd);   // Main loop re-evaluates the color timer
     }
 
     // Close window
     static void xdg_toplevel_close(void* data, struct xdg_toplevel* toplevel) {
-        WaylandWindow* self = static_cast<WaylandWindow*>(data);
-        for (int i = 0; i < 2; ++i) {
-            if (self->windows[i].xdg_toplevel == toplevel) {
-                std::cout << "❌ Window " << i+1 << " closed.\n";
-                self->running = false;
-                return;
-            }
-        }
+        Window* win = static_cast<Window*>(data);
+        protocol_event(win->event_stats);
+        LOG_INFO << "❌ Window " << win->index+1 << " closed.";
+        win->owner->stop();
     }
 
 public:
     WaylandWindow() : display(nullptr), registry(nullptr), compositor(nullptr),
-                      wm_base(nullptr), shm(nullptr) {
-        for (int i = 0; i < 2; ++i) {
-            windows[i].surface = nullptr;
-            windows[i].xdg_surface = nullptr;
-            windows[i].xdg_toplevel = nullptr;
-            windows[i].buffer = nullptr;
-            windows[i].output = nullptr;
-            windows[i].shm_data = nullptr;
-            windows[i].width = 800;
-            windows[i].height = 600;
-            windows[i].configured = false;
-            windows[i].toplevel_configured = false;
-            snprintf(windows[i].title, sizeof(windows[i].title), "Window %d", i+1);
-        }
-    }
+                      wm_base(nullptr), shm(nullptr), viewporter(nullptr),
+                      single_pixel_manager(nullptr), presentation(nullptr) {}
 
     ~WaylandWindow() {
-        for (int i = 0; i < 2; ++i) {
-            if (windows[i].buffer) wl_buffer_destroy(windows[i].buffer);
-            if (windows[i].shm_data) munmap(windows[i].shm_data, windows[i].width * windows[i].height * PIXEL_SIZE);
-            if (windows[i].xdg_toplevel) xdg_toplevel_destroy(windows[i].xdg_toplevel);
-            if (windows[i].xdg_surface) xdg_surface_destroy(windows[i].xdg_surface);
-            if (windows[i].surface) wl_surface_destroy(windows[i].surface);
+        for (auto& win : windows) {
+            destroy_window(*win);
         }
+        if (wake_fd != -1) close(wake_fd);
         if (wm_base) xdg_wm_base_destroy(wm_base);
         if (compositor) wl_compositor_destroy(compositor);
         if (shm) wl_shm_destroy(shm);
-        for (auto* out : outputs) wl_output_destroy(out);
+        if (viewporter) wp_viewporter_destroy(viewporter);
+        if (single_pixel_manager) wp_single_pixel_buffer_manager_v1_destroy(single_pixel_manager);
+        if (presentation) wp_presentation_destroy(presentation);
+        for (auto& out : outputs) {
+            if (out->xdg_output) zxdg_output_v1_destroy(out->xdg_output);
+            wl_output_destroy(out->output);
+        }
+        if (xdg_output_manager) zxdg_output_manager_v1_destroy(xdg_output_manager);
+        if (fractional_scale_manager) wp_fractional_scale_manager_v1_destroy(fractional_scale_manager);
         if (registry) wl_registry_destroy(registry);
         if (display) wl_display_disconnect(display);
     }
 
     bool initialize() {
+        ProtocolScope protocol_scope(startup_protocol);
         display = wl_display_connect(nullptr);
         if (!display) {
-            std::cerr << "❌ Failed to connect to Wayland display\n";
+            LOG_ERROR << "❌ Failed to connect to Wayland display";
+            return false;
+        }
+
+        if (!timers.init()) {
+            return false;
+        }
+
+        if (pipe2(stats_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+            perror("pipe2");
             return false;
         }
+        struct sigaction action = {};
+        action.sa_handler = stats_signal;
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &action, nullptr);
 
         registry = wl_display_get_registry(display);
+        protocol_request();
         wl_registry_add_listener(registry, &registry_listener_impl, this);
 
         //wl_display_roundtrip(display);
 
 		wl_display_dispatch(display);
 		wl_display_roundtrip(display);
+		protocol_request();   // wl_display.sync
+		wl_display_roundtrip(display);   // Output and xdg_output state of the bound globals
+		protocol_request();
 
 
 		if (!compositor || !wm_base || !shm) {
-            std::cerr << "❌ Missing required interfaces: compositor, xdg_wm_base, wl_shm\n";
+            LOG_ERROR << "❌ Missing required interfaces: compositor, xdg_wm_base, wl_shm";
             return false;
         }
 
-        if (outputs.size() < 2) {
-            std::cerr << "❌ Need at least 2 monitors. Found: " << outputs.size() << "\n";
-            for (size_t i = 0; i < outputs.size(); ++i) {
-                std::cerr << "  Output " << i << ": " << output_names[i] << "\n";
-            }
+        if (outputs.empty()) {
+            LOG_ERROR << "❌ No monitors found";
             return false;
         }
 
         // Print monitor resolutions BEFORE creating windows
-        std::cout << "\n=== MONITOR RESOLUTIONS ===\n";
+        LOG_INFO << "=== MONITOR RESOLUTIONS ===";
         for (size_t i = 0; i < outputs.size(); ++i) {
-            int w = output_widths[i];
-            int h = output_heights[i];
+            const Output& out = *outputs[i];
+            int w = out.current.mode_width;
+            int h = out.current.mode_height;
+            int logical_w, logical_h;
+            logical_size(out.current, logical_w, logical_h);
             if (w == 0 || h == 0) {
                 // Fallback: use default if mode not received yet
                 w = 1920; h = 1080;
-                std::cout << "⚠️  Output " << i << " (" << output_names[i] << ") resolution unknown — using fallback " << w << "x" << h << "\n";
+                LOG_WARN << "⚠️  Output " << i << " (" << out.name << ") resolution unknown — using fallback " << w << "x" << h;
             } else {
-                std::cout << "✅ Output " << i << " (" << output_names[i] << "): " << w << "x" << h << "\n";
+                LOG_INFO << "✅ Output " << i << " (" << out.name << "): " << w << "x" << h
+                         << " @ " << out.current.refresh_mhz / 1000.0 << " Hz, scale " << out.current.scale
+                         << ", transform " << out.current.transform
+                         << ", logical " << logical_w << "x" << logical_h;
             }
         }
-        std::cout << "=========================\n\n";
+        LOG_INFO << "===========================";
 
-        // Assign outputs to windows
-        for (int i = 0; i < 2; ++i) {
-            windows[i].output = outputs[i];
-            // Use detected resolution as initial size
-            windows[i].width = output_widths[i] > 0 ? output_widths[i] : 1920;
-            windows[i].height = output_heights[i] > 0 ? output_heights[i] : 1080;
+        choose_format();
 
-            std::cout << "🎯 Window " << i+1 << " assigned to: " << output_names[i] << " (" << windows[i].width << "x" << windows[i].height << ")\n";
+        if (fractional_scale_manager && viewporter) {
+            LOG_INFO << "🔍 Fractional scaling via wp_fractional_scale_v1 and wp_viewporter";
+        }
+        if (dynamic_scale) {
+            if (!viewporter) {
+                LOG_WARN << "⚠️  Dynamic resolution needs wp_viewporter, rendering at native size";
+            } else if (frame_budget_us) {
+                LOG_INFO << "📐 Dynamic resolution: frame budget " << frame_budget_us / 1000.0 << " ms";
+            } else {
+                LOG_INFO << "📐 Dynamic resolution: frame budget " << RENDER_BUDGET_PERCENT
+                         << "% of the refresh interval";
+            }
+        }
+        if (viewporter && single_pixel_manager && !animate && !tile_damage) {
+            LOG_INFO << "⚡ Using single-pixel buffers scaled by wp_viewporter for solid colors";
+        } else {
+            LOG_INFO << "🧮 Fill kernel: " << pixel_fill_kernel().name << " (non-temporal above "
+                     << pixel_fill_llc_size() / 1024 << " KiB), " << render_pool.size() << " render threads";
+        }
 
-            windows[i].surface = wl_compositor_create_surface(compositor);
-            if (!windows[i].surface) {
-                std::cerr << "❌ Failed to create surface for window " << i+1 << "\n";
+        if (threaded) {
+            wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wake_fd == -1) {
+                perror("eventfd");
                 return false;
             }
+        }
 
-            windows[i].xdg_surface = xdg_wm_base_get_xdg_surface(wm_base, windows[i].surface);
-            xdg_surface_add_listener(windows[i].xdg_surface, &xdg_surface_listener_impl, this);
-
-            windows[i].xdg_toplevel = xdg_surface_get_toplevel(windows[i].xdg_surface);
-            xdg_toplevel_add_listener(windows[i].xdg_toplevel, &xdg_toplevel_listener_impl, this);
-
-            xdg_toplevel_set_title(windows[i].xdg_toplevel, windows[i].title);
+        // One window per output
+        windows.reserve(outputs.size());
+        for (auto& out : outputs) {
+            if (!open_window(*out)) return false;
         }
 
         // Initialize first colors
         update_colors();
+        for (auto& win : windows) {
+            sync_color(*win);
+        }
 
         // Commit surfaces to trigger configure events
-        for (int i = 0; i < 2; ++i) {
-            wl_surface_commit(windows[i].surface);
-            std::cout << "⏳ Waiting for configure events for window " << i+1 << "...\n";
+        for (auto& win : windows) {
+            wl_surface_commit(win->surface);
+            protocol_request();
+            LOG_INFO << "⏳ Waiting for configure events for window " << win->index+1 << "...";
         }
 
+        started = true;
         return true;
     }
 
+    // Window for an output. Fullscreen is requested once, before the first
+    // commit, so the first configure already carries the output's size.
+    bool open_window(Output& out) {
+        Window& win = add_window();
+        win.output = &out;
+        out.window = &win;
+        if (!threaded) win.event_stats = &win.protocol;
+        win.pool.count_events(win.event_stats);
+        win.cache.count_events(win.event_stats);
+        // Start from the output's logical size; configure has the final word
+        logical_size(out.current, win.surface_width, win.surface_height);
+        win.buffer_scale = out.current.scale;
+        win.output_scale.store(out.current.scale, std::memory_order_relaxed);
+        if (compositor_version >= 2) win.buffer_transform = out.current.transform;
+        win.output_transform.store(win.buffer_transform, std::memory_order_relaxed);
+        win.output_mode.store(mode_key(out.current), std::memory_order_relaxed);
+        win.refresh_mhz.store(out.current.refresh_mhz, std::memory_order_relaxed);
+        update_buffer_size(win);
+
+        LOG_INFO << "🎯 Window " << win.index+1 << " assigned to: " << out.name << " (" << win.width << "x" << win.height << ")";
+
+        if (!create_surface(win)) {
+            LOG_ERROR << "❌ Failed to create surface for window " << win.index+1;
+            return false;
+        }
+        xdg_surface_add_listener(win.xdg_surface, &xdg_surface_listener_impl, &win);
+
+        // Every format drawn is XRGB: the compositor may skip blending and
+        // put the buffer straight on a plane. Larger than any surface, so
+        // resizes need no update.
+        struct wl_region* opaque = wl_compositor_create_region(compositor);
+        protocol_request();
+        wl_region_add(opaque, 0, 0, INT32_MAX, INT32_MAX);
+        protocol_request();
+        wl_surface_set_opaque_region(win.surface, opaque);
+        protocol_request();
+        wl_region_destroy(opaque);
+        protocol_request();
+
+        win.xdg_toplevel = xdg_surface_get_toplevel(win.xdg_surface);
+        protocol_request();
+        xdg_toplevel_add_listener(win.xdg_toplevel, &xdg_toplevel_listener_impl, &win);
+
+        xdg_toplevel_set_title(win.xdg_toplevel, win.title);
+        protocol_request();
+        xdg_toplevel_set_fullscreen(win.xdg_toplevel, out.output);
+        protocol_request();
+
+        if (win.fractional_scale) {
+            wp_fractional_scale_v1_add_listener(win.fractional_scale, &fractional_scale_listener_impl, &win);
+        }
+
+        win.solid = viewporter && single_pixel_manager && !animate && !tile_damage;
+        win.cache.set_budget(animate || tile_damage ? nullptr : &cache_budget);
+        win.palette.clear();
+        for (int step = 0; step < NUM_COLORS; ++step) {
+            uint32_t color = window_color(step, win.index).value;
+            if (std::find(win.palette.begin(), win.palette.end(), color) == win.palette.end())
+                win.palette.push_back(color);
+        }
+        if (viewporter) {
+            win.viewport = wp_viewporter_get_viewport(viewporter, win.surface);
+            protocol_request();
+        }
+        return true;
+    }
+
+    // Tear down the window of an unplugged output, leaving the others alone
+    void close_window(Window& win) {
+        if (win.output) win.output->window = nullptr;
+        destroy_window(win);
+        for (auto it = windows.begin(); it != windows.end(); ++it) {
+            if (it->get() == &win) {
+                windows.erase(it);
+                return;
+            }
+        }
+    }
+
+    void destroy_window(Window& win) {
+        if (win.thread.joinable()) {
+            win.closing = true;
+            wake(win.wake_fd);
+            win.thread.join();
+        }
+
+        if (win.frame_callback) wl_callback_destroy(win.frame_callback);
+        for (auto& slot : win.feedbacks) {
+            if (slot.feedback) wp_presentation_feedback_destroy(slot.feedback);
+        }
+        win.pool.destroy();
+        for (auto& solid : win.solid_buffers) {
+            wl_buffer_destroy(solid.second);
+            protocol_request();
+        }
+        win.cache.clear();
+        if (win.viewport) {
+            wp_viewport_destroy(win.viewport);
+            protocol_request();
+        }
+        if (win.fractional_scale) {
+            wp_fractional_scale_v1_destroy(win.fractional_scale);
+            protocol_request();
+        }
+        if (win.xdg_toplevel) {
+            xdg_toplevel_destroy(win.xdg_toplevel);
+            protocol_request();
+        }
+        if (win.xdg_surface) {
+            xdg_surface_destroy(win.xdg_surface);
+            protocol_request();
+        }
+        if (win.surface) {
+            wl_surface_destroy(win.surface);
+            protocol_request();
+        }
+        if (win.queue) {
+            if (win.shm) wl_proxy_wrapper_destroy(win.shm);
+            if (win.presentation) wl_proxy_wrapper_destroy(win.presentation);
+            wl_event_queue_destroy(win.queue);
+        }
+        if (win.wake_fd != -1) close(win.wake_fd);
+
+        win.frame_callback = nullptr;
+        win.viewport = nullptr;
+        win.fractional_scale = nullptr;
+        win.xdg_toplevel = nullptr;
+        win.xdg_surface = nullptr;
+        win.surface = nullptr;
+        win.queue = nullptr;
+        win.wake_fd = -1;
+        win.solid_buffers.clear();
+    }
+
+    // Windows pick the new entry up in sync_color(), on whichever thread draws them
+    Window& add_window() {
+        windows.push_back(std::make_unique<Window>());
+        Window& win = *windows.back();
+        win.owner = this;
+        win.index = next_window_index++;
+        snprintf(win.title, sizeof(win.title), "Window %d", win.index+1);
+        return win;
+    }
+
+    // Proxy wrapper that puts the objects created through it on queue, so
+    // their first events cannot reach the default queue before
+    // wl_proxy_set_queue could move them
+    template <typename T>
+    static T* queue_wrapper(T* proxy, struct wl_event_queue* queue) {
+        T* wrapper = static_cast<T*>(wl_proxy_create_wrapper(proxy));
+        wl_proxy_set_queue(reinterpret_cast<struct wl_proxy*>(wrapper), queue);
+        return wrapper;
+    }
+
+    // Surface and xdg objects of a window. In threaded mode they, and every
+    // buffer, frame callback and feedback derived from them, are created on
+    // the window's own event queue.
+    bool create_surface(Window& win) {
+        if (!threaded) {
+            win.shm = shm;
+            win.presentation = presentation;
+            win.surface = wl_compositor_create_surface(compositor);
+            if (!win.surface) return false;
+            protocol_request();
+            win.xdg_surface = xdg_wm_base_get_xdg_surface(wm_base, win.surface);
+            protocol_request();
+            if (fractional_scale_manager) {
+                win.fractional_scale = wp_fractional_scale_manager_v1_get_fractional_scale(
+                    fractional_scale_manager, win.surface);
+                protocol_request();
+            }
+            return true;
+        }
+
+        win.queue = wl_display_create_queue(display);
+        if (!win.queue) return false;
+        win.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (win.wake_fd == -1) {
+            perror("eventfd");
+            return false;
+        }
+
+        win.shm = queue_wrapper(shm, win.queue);
+        if (presentation) win.presentation = queue_wrapper(presentation, win.queue);
+
+        struct wl_compositor* compositor_wrapper = queue_wrapper(compositor, win.queue);
+        win.surface = wl_compositor_create_surface(compositor_wrapper);
+        wl_proxy_wrapper_destroy(compositor_wrapper);
+        if (!win.surface) return false;
+        protocol_request();
+
+        struct xdg_wm_base* wm_base_wrapper = queue_wrapper(wm_base, win.queue);
+        win.xdg_surface = xdg_wm_base_get_xdg_surface(wm_base_wrapper, win.surface);
+        protocol_request();
+        wl_proxy_wrapper_destroy(wm_base_wrapper);
+
+        if (fractional_scale_manager) {
+            struct wp_fractional_scale_manager_v1* fractional_wrapper = queue_wrapper(fractional_scale_manager, win.queue);
+            win.fractional_scale = wp_fractional_scale_manager_v1_get_fractional_scale(fractional_wrapper, win.surface);
+            protocol_request();
+            wl_proxy_wrapper_destroy(fractional_wrapper);
+        }
+        return true;
+    }
+
+    // Buffer pixels for the logical size, exactly what the compositor shows:
+    // scaled by the fractional scale when the viewport can map it back,
+    // otherwise by the output's integer scale, then by the dynamic render
+    // scale, in the orientation of the output. Returns whether it changed.
+    bool update_buffer_size(Window& win) {
+        int width, height;
+        if (win.scale_120 && win.viewport) {
+            width = (win.surface_width * static_cast<int>(win.scale_120) + 60) / 120;
+            height = (win.surface_height * static_cast<int>(win.scale_120) + 60) / 120;
+        } else {
+            int scale = compositor_version >= 3 ? win.buffer_scale : 1;
+            width = win.surface_width * scale;
+            height = win.surface_height * scale;
+        }
+
+        // Dynamic resolution draws fewer pixels and the viewport upscales them
+        if (win.viewport) {
+            width = win.render_scale.apply(width);
+            height = win.render_scale.apply(height);
+        }
+
+        // Pre-rotated for 90 and 270 degree outputs
+        if (win.buffer_transform & 1) std::swap(width, height);
+        if (width == win.width && height == win.height) return false;
+
+        win.width = width;
+        win.height = height;
+        win.scale_dirty = true;
+        win.needs_redraw = true;
+        return true;
+    }
+
+    // Pick up a scale or transform change committed on the window's output
+    void sync_scale(Window& win) {
+        int scale = win.output_scale.load(std::memory_order_relaxed);
+        int transform = compositor_version >= 2 ? win.output_transform.load(std::memory_order_relaxed)
+                                                : WL_OUTPUT_TRANSFORM_NORMAL;
+        if (scale == win.buffer_scale && transform == win.buffer_transform) return;
+        win.buffer_scale = scale;
+        win.buffer_transform = transform;
+        win.scale_dirty = true;
+        win.needs_redraw = true;
+        update_buffer_size(win);
+    }
+
     void update_colors() {
-        for (int i = 0; i < 2; ++i) {
-            windows[i].color = COLORS[current_color_index][i];
-        }
-        std::cout << "🎨 Changing colors to index " << current_color_index << " — ";
-        for (int i = 0; i < 2; ++i) {
-            std::cout << "Window " << i+1 << ": " << (windows[i].color == 0x00FF0000 ? "Red" :
-                                                     windows[i].color == 0x000000FF ? "Blue" :
-                                                     windows[i].color == 0x0000FF00 ? "Green" :
-                                                     windows[i].color == 0x00FFFF00 ? "Yellow" :
-                                                     windows[i].color == 0x00800080 ? "Purple" :
-                                                     windows[i].color == 0x0000FFFF ? "Cyan" :
-                                                     windows[i].color == 0x00FF00FF ? "Magenta" :
-                                                     windows[i].color == 0x00FFA500 ? "Orange" : "Unknown")
-                           << " | ";
-        }
-        std::cout << "\n";
-    }
-
-    void create_buffer(int index) {
-        auto& win = windows[index];
-        int stride = win.width * PIXEL_SIZE;
-        int size = stride * win.height;
-
-        int fd = memfd_create("wayland-buffer", MFD_CLOEXEC);
-        if (fd == -1) {
-            perror("memfd_create");
+        TraceSpan span("update colors");
+        int index = current_color_index.load(std::memory_order_relaxed);
+        if (LOG_LEVEL > LOG_LEVEL_INFO) return;
+
+        LogLine line(LogLevel::Info);
+        line << "🎨 Changing colors to index " << index << " — ";
+        for (auto& win : windows) {
+            line << "Window " << win->index+1 << ": " << window_color(index, win->index).name << " | ";
+        }
+    }
+
+    void sync_color(Window& win) {
+        int index = current_color_index.load(std::memory_order_acquire);
+        if (win.color_index == index) return;
+        win.color_index = index;
+        win.color = window_color(index, win.index).value;
+        win.needs_redraw = true;
+    }
+
+    // Returns the 1x1 single-pixel buffer for color, creating it on first use
+    struct wl_buffer* solid_buffer(Window& win, uint32_t color) {
+        for (auto& solid : win.solid_buffers) {
+            if (solid.first == color) return solid.second;
+        }
+
+        // Expand 8-bit XRGB channels to the protocol's 32-bit premultiplied RGBA
+        uint32_t r = ((color >> 16) & 0xFF) * 0x01010101u;
+        uint32_t g = ((color >> 8) & 0xFF) * 0x01010101u;
+        uint32_t b = (color & 0xFF) * 0x01010101u;
+        struct wl_buffer* buffer = wp_single_pixel_buffer_manager_v1_create_u32_rgba_buffer(
+            single_pixel_manager, r, g, b, 0xFFFFFFFFu);
+        protocol_request();
+        wl_buffer_add_listener(buffer, &solid_buffer_listener_impl, &win);
+        win.solid_buffers.emplace_back(color, buffer);
+        return buffer;
+    }
+
+    // Render task: fill rows [begin, end) of a window's SHM buffer, over
+    // the columns of a Window::FillSpan
+    template <typename Format>
+    static void fill_rows(void* ctx, size_t begin, size_t end) {
+        typedef typename Format::Pixel Pixel;
+        const Window::FillSpan* columns = static_cast<const Window::FillSpan*>(ctx);
+        Window* win = columns->win;
+        TraceSpan span("fill", win->index);
+        size_t width = static_cast<size_t>(win->width);
+        // Tile rows are hashed right after filling: keep them in cache
+        bool stream = !win->owner->tile_damage && pixel_fill_streams(width * win->height * sizeof(Pixel));
+        Pixel* pixels = static_cast<Pixel*>(win->shm_data);
+        uint32_t inverse = ~win->color & 0x00FFFFFF;
+
+        // Columns [x, x + count) of rows [first, last); whole rows in one span
+        auto fill = [&](size_t first, size_t last, size_t x, size_t count, uint32_t rgb) {
+            if (first >= last || count == 0) return;
+            if (count == width) {
+                pixel_fill_span<Format>(pixels + first * width, (last - first) * width, rgb, stream);
+                return;
+            }
+            for (size_t row = first; row < last; ++row) {
+                pixel_fill_span<Format>(pixels + row * width + x, count, rgb, stream);
+            }
+        };
+
+        // Rows covered by the animated bar get it in the inverted color
+        const Rect& bar = win->bar;
+        size_t x0 = static_cast<size_t>(columns->x0), x1 = static_cast<size_t>(columns->x1);
+        PerfScope perf(win->fill_perf, (end - begin) * (x1 - x0));
+        size_t bar_begin = end, bar_end = end, bar_x0 = x0, bar_x1 = x0;
+        if (!bar.empty()) {
+            bar_begin = std::min(std::max(begin, static_cast<size_t>(bar.y)), end);
+            bar_end = std::min(std::max(begin, static_cast<size_t>(bar.y + bar.height)), end);
+            bar_x0 = std::min(std::max(x0, static_cast<size_t>(bar.x)), x1);
+            bar_x1 = std::min(std::max(x0, static_cast<size_t>(bar.x + bar.width)), x1);
+        }
+
+        fill(begin, bar_begin, x0, x1 - x0, win->color);
+        fill(bar_begin, bar_end, x0, bar_x0 - x0, win->color);
+        fill(bar_begin, bar_end, bar_x0, bar_x1 - bar_x0, inverse);
+        fill(bar_begin, bar_end, bar_x1, x1 - bar_x1, win->color);
+        fill(bar_end, end, x0, x1 - x0, win->color);
+    }
+
+    static void (*fill_kernel_for(PixelFormat format))(void*, size_t, size_t) {
+        switch (format) {
+        case PixelFormat::RGB565: return fill_rows<FormatRGB565>;
+        case PixelFormat::XRGB2101010: return fill_rows<FormatXRGB2101010>;
+        default: return fill_rows<FormatXRGB8888>;
+        }
+    }
+
+    // Render task: fill rows [begin, end) of a palette cache entry with its
+    // color. The compositor reads it, we never do.
+    template <typename Format>
+    static void fill_palette_rows(void* ctx, size_t begin, size_t end) {
+        typedef typename Format::Pixel Pixel;
+        const BufferCache::Entry* entry = static_cast<const BufferCache::Entry*>(ctx);
+        TraceSpan span("palette fill");
+        size_t width = static_cast<size_t>(entry->width);
+        Pixel* pixels = static_cast<Pixel*>(entry->data);
+        pixel_fill_span<Format>(pixels + begin * width, (end - begin) * width, entry->color,
+                                pixel_fill_streams(entry->size));
+    }
+
+    static void (*palette_kernel_for(PixelFormat format))(void*, size_t, size_t) {
+        switch (format) {
+        case PixelFormat::RGB565: return fill_palette_rows<FormatRGB565>;
+        case PixelFormat::XRGB2101010: return fill_palette_rows<FormatXRGB2101010>;
+        default: return fill_palette_rows<FormatXRGB8888>;
+        }
+    }
+
+    void use_format(PixelFormat f) {
+        format = &pixel_format_info(f);
+        fill_kernel = fill_kernel_for(f);
+        palette_kernel = palette_kernel_for(f);
+    }
+
+    // Cheapest advertised format that shows the palette exactly (and its
+    // inverse when the bar is drawn), unless one was forced and is available
+    void choose_format() {
+        if (format_forced && !(shm_formats & pixel_format_bit(format->format))) {
+            LOG_WARN << "⚠️  Compositor does not support " << format->name << ", choosing a format";
+            format_forced = false;
+        }
+        if (!format_forced) {
+            std::vector<uint32_t> colors;
+            for (const PaletteColor& color : COLORS) {
+                colors.push_back(color.value);
+                if (animate) colors.push_back(~color.value & 0x00FFFFFF);
+            }
+            use_format(pixel_format_choose(shm_formats | pixel_format_bit(PixelFormat::XRGB8888),
+                                           colors.data(), colors.size()));
+        }
+        LOG_INFO << "🎨 Pixel format: " << format->name << " (" << format->bytes << " bytes/pixel"
+                 << (format_forced ? ", forced" : "") << ")";
+    }
+
+    // --tile-damage: fill tile rows [begin, end) and hash them while they
+    // are still in cache
+    static void fill_hash_rows(void* ctx, size_t begin, size_t end) {
+        Window* win = static_cast<Window*>(ctx);
+        size_t first = begin * TileHasher::TILE_SIZE;
+        size_t last = std::min(end * TileHasher::TILE_SIZE, static_cast<size_t>(win->height));
+        win->owner->fill_kernel(&win->fill_spans[0], first, last);
+
+        TraceSpan span("hash", win->index);
+        PerfScope perf(win->hash_perf, (last - first) * win->width);
+        uint64_t start = TimerQueue::now_ns();
+        win->tiles.hash_rows(win->shm_data, static_cast<size_t>(win->width) * win->owner->format->bytes, begin, end);
+        win->hash_ns.fetch_add(TimerQueue::now_ns() - start, std::memory_order_relaxed);
+    }
+
+    // Pick the buffer a window draws into next and queue its pixel work
+    bool prepare_buffer(Window& win, std::vector<RenderTask>& tasks) {
+        TraceSpan span("acquire buffer", win.index);
+        if (win.solid) {
+            // Solid color: let the compositor scale a 1x1 buffer, nothing to fill
+            win.buffer = solid_buffer(win, win.color);
+            wp_viewport_set_destination(win.viewport, win.surface_width, win.surface_height);
+            protocol_request();
+            return true;
+        }
+
+        if (win.scale_dirty) {
+            // Fractional and dynamic render scales map the buffer back
+            // through the viewport, the integer scale through the surface
+            bool viewport_scaled = win.viewport && (win.scale_120 || win.render_scale.percent() != 100);
+            if (viewport_scaled) {
+                wp_viewport_set_destination(win.viewport, win.surface_width, win.surface_height);
+                protocol_request();
+            }
+            int32_t surface_scale = viewport_scaled ? 1 : win.buffer_scale;
+            if (compositor_version >= 3 && surface_scale != win.sent_buffer_scale) {
+                wl_surface_set_buffer_scale(win.surface, surface_scale);
+                protocol_request();
+                win.sent_buffer_scale = surface_scale;
+            }
+            if (win.buffer_transform != win.sent_buffer_transform) {
+                wl_surface_set_buffer_transform(win.surface, win.buffer_transform);
+                protocol_request();
+                win.sent_buffer_transform = win.buffer_transform;
+            }
+            win.scale_dirty = false;
+        }
+
+        if (animate) {
+            uint32_t phase = win.frame_time % ANIMATION_PERIOD_MS;
+            win.bar = bar_rect(win, static_cast<int>(phase));
+        }
+        track_damage(win);
+
+        // Static content: the whole palette is rendered into the cache the
+        // first time a size is drawn, after which a color change attaches a
+        // ready buffer. A palette that does not fit the budget uses the pool.
+        if (win.cache.enabled()) {
+            uint64_t refusals = win.cache.stats().refusals.load(std::memory_order_relaxed);
+            win.cache_fills.clear();
+            if (win.cache.populate(win.shm, win.palette, win.width, win.height, format->shm_format,
+                                   format->bytes, win.cache_fills)) {
+                queue_palette_fill(win, tasks);
+                BufferCache::Entry* entry = win.cache.lookup(win.color);
+                if (entry) {
+                    win.buffer = entry->buffer;
+                    return true;
+                }
+            } else if (win.cache.stats().refusals.load(std::memory_order_relaxed) != refusals) {
+                size_t bytes = static_cast<size_t>(win.width) * win.height * format->bytes * win.palette.size();
+                LOG_INFO << "🗃️ Window " << win.index+1 << ": palette of " << win.palette.size() << " colors needs "
+                         << (bytes >> 20) << " MiB, " << ((cache_budget.limit() - cache_budget.used()) >> 20)
+                         << " MiB left in the cache budget, drawing through the pool";
+            }
+        }
+
+        // Slots are only re-carved when the configured size changes
+        if (!win.pool.configure(win.shm, win.width, win.height, format->shm_format, format->bytes))
+            return false;
+
+        ShmPool::Buffer* slot = win.pool.acquire();
+        if (!slot) {
+            LOG_WARN << "⚠️  No free buffer for window " << win.index+1 << " — compositor still holds all slots";
+            return false;
+        }
+        win.buffer = slot->buffer;
+        win.shm_data = slot->data;
+
+        if (tile_damage) {
+            // Drawn like content that cannot report its own damage: all of
+            // it, every frame. The tile hashes find what changed.
+            win.tiles.resize(win.width, win.height, format->bytes);
+            win.repaint.clear();
+            win.repaint.add({ 0, 0, win.width, win.height });
+        } else {
+            // The slot still holds the frame it was last drawn for: repaint
+            // only what changed since then
+            unsigned age = slot->frame ? static_cast<unsigned>(win.damage.frame() - slot->frame) : 0;
+            win.repaint = win.damage.repaint(age);
+        }
+        slot->frame = win.damage.frame();
+
+        queue_fill(win, tasks);
+        return true;
+    }
+
+    // The bar sweeps down the surface; in the buffer that is the transform
+    // applied to it (surface y lands on buffer x for 90 and 270 degrees,
+    // flipped for 90 and 180). Mirroring does not move a full-width bar.
+    static Rect bar_rect(const Window& win, int phase_ms) {
+        bool rotated = win.buffer_transform & 1;
+        int sweep = rotated ? win.width : win.height;
+        int y = static_cast<int>(static_cast<uint64_t>(phase_ms) * sweep / ANIMATION_PERIOD_MS);
+        int flipped = sweep - y - ANIMATION_BAR_HEIGHT;
+
+        Rect bar;
+        switch (win.buffer_transform & 3) {
+        case WL_OUTPUT_TRANSFORM_90: bar = { flipped, 0, ANIMATION_BAR_HEIGHT, win.height }; break;
+        case WL_OUTPUT_TRANSFORM_180: bar = { 0, flipped, win.width, ANIMATION_BAR_HEIGHT }; break;
+        case WL_OUTPUT_TRANSFORM_270: bar = { y, 0, ANIMATION_BAR_HEIGHT, win.height }; break;
+        default: bar = { 0, y, win.width, ANIMATION_BAR_HEIGHT }; break;
+        }
+        return bar.intersected({ 0, 0, win.width, win.height });
+    }
+
+    // What changed since the previous frame: everything after a resize or a
+    // color change, otherwise where the bar was and where it is now
+    void track_damage(Window& win) {
+        if (win.damage.width() != win.width || win.damage.height() != win.height) {
+            win.damage.reset(win.width, win.height);
+        } else if (win.color != win.drawn_color) {
+            win.damage.add_all();
+        } else if (win.bar != win.drawn_bar) {
+            win.damage.add(win.drawn_bar);
+            win.damage.add(win.bar);
+        }
+        win.drawn_color = win.color;
+        win.drawn_bar = win.bar;
+    }
+
+    // Fill the repaint region of win.shm_data, in cache-line aligned row
+    // bands. The region is disjoint and each rect is filled over its own
+    // columns, so a sideways bar costs its own columns rather than whole
+    // rows and no pixel is written twice. A window thread fills each rect
+    // in one pass instead.
+    void queue_fill(Window& win, std::vector<RenderTask>& tasks) {
+        if (tile_damage) {
+            win.fill_spans.assign(1, { &win, 0, win.width });
+            // One task per tile row, hashed as soon as it is filled
+            for (int row = 0; row < win.tiles.rows(); ++row) {
+                tasks.push_back({ fill_hash_rows, &win, static_cast<size_t>(row), static_cast<size_t>(row) + 1 });
+            }
+            uint64_t pixels = static_cast<uint64_t>(win.width) * win.height;
+            win.repaint_pixels.fetch_add(pixels, std::memory_order_relaxed);
+            win.frame_pixels.fetch_add(pixels, std::memory_order_relaxed);
             return;
         }
+        // Complete before the tasks take pointers into it
+        win.fill_spans.clear();
+        for (const Rect& rect : win.repaint.rects()) {
+            win.fill_spans.push_back({ &win, rect.x, rect.x + rect.width });
+        }
+        for (size_t i = 0; i < win.fill_spans.size(); ++i) {
+            const Rect& rect = win.repaint.rects()[i];
+            Window::FillSpan* columns = &win.fill_spans[i];
+            size_t first = static_cast<size_t>(rect.y);
+            size_t last = static_cast<size_t>(rect.y + rect.height);
+            if (threaded) {
+                tasks.push_back({ fill_kernel, columns, first, last });
+            } else {
+                render_pool.split_rows(tasks, fill_kernel, columns, first, last, static_cast<size_t>(win.width) * format->bytes);
+            }
+            win.repaint_pixels.fetch_add(static_cast<uint64_t>(rect.area()), std::memory_order_relaxed);
+        }
+        win.frame_pixels.fetch_add(static_cast<uint64_t>(win.width) * win.height, std::memory_order_relaxed);
+    }
+
+    // Render every palette entry populate() just created, before any of
+    // them is attached
+    void queue_palette_fill(Window& win, std::vector<RenderTask>& tasks) {
+        for (BufferCache::Entry* entry : win.cache_fills) {
+            size_t rows = static_cast<size_t>(entry->height);
+            if (threaded) {
+                tasks.push_back({ palette_kernel, entry, 0, rows });
+            } else {
+                render_pool.split_rows(tasks, palette_kernel, entry, rows, entry->size / rows);
+            }
+            uint64_t pixels = static_cast<uint64_t>(entry->width) * entry->height;
+            win.repaint_pixels.fetch_add(pixels, std::memory_order_relaxed);
+            win.frame_pixels.fetch_add(pixels, std::memory_order_relaxed);
+        }
+    }
+
+    void present_buffer(Window& win) {
+        // Attach and damage
+        wl_surface_attach(win.surface, win.buffer, 0, 0);
+        protocol_request();
+        const DamageRegion* damage = &win.damage.current();
+        if (tile_damage) {
+            win.changed_tiles.clear();
+            win.tiles_changed.fetch_add(win.tiles.collect(win.changed_tiles), std::memory_order_relaxed);
+            win.tiles_hashed.fetch_add(win.tiles.tiles(), std::memory_order_relaxed);
+            damage = &win.changed_tiles;
+        }
+        if (win.solid || compositor_version < 4) {
+            wl_surface_damage(win.surface, 0, 0, win.surface_width, win.surface_height);
+            protocol_request();
+        } else {
+            // Buffer coordinates: no rounding through the surface scale
+            for (const Rect& rect : damage->rects()) {
+                wl_surface_damage_buffer(win.surface, rect.x, rect.y, rect.width, rect.height);
+                protocol_request();
+            }
+        }
+        win.damage.commit();
+
+        request_feedback(win);
+
+        // Ask to be told when this frame is shown; never more than one in flight
+        if (!win.frame_callback) {
+            win.frame_callback = wl_surface_frame(win.surface);
+            protocol_request();
+            wl_callback_add_listener(win.frame_callback, &frame_listener_impl, &win);
+        }
+        win.needs_redraw = false;
+        ++win.frames;
+    }
+
+    // Presentation feedback for the commit that follows. With every slot
+    // in flight the commit goes unmeasured, and is counted as such.
+    void request_feedback(Window& win) {
+        if (!win.presentation) return;
+
+        for (auto& slot : win.feedbacks) {
+            if (slot.feedback) continue;
+
+            struct timespec ts;
+            clock_gettime(presentation_clock, &ts);
+            slot.win = &win;
+            slot.commit_ns = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+            slot.feedback = wp_presentation_feedback(win.presentation, win.surface);
+            protocol_request();
+            wp_presentation_feedback_add_listener(slot.feedback, &feedback_listener_impl, &slot);
+            return;
+        }
+        win.presentation_stats.record_unmeasured();
+    }
+
+    void dump_stats() {
+        log_flush();   // Queued lines first, the report must not interleave with them
+        std::cout << "\n=== PRESENTATION STATS ===\n";
+        if (!presentation) {
+            std::cout << "⚠️  Compositor does not support wp_presentation\n";
+        }
+        for (auto& win : windows) {
+            std::string label = "Window " + std::to_string(win->index+1) + " on output " + win->output->name;
+            win->presentation_stats.dump(std::cout, label.c_str());
+            std::cout << "    configure  " << win->configures << " received, " << win->reallocations
+                      << " reallocations, " << win->reallocations_avoided << " avoided\n";
+            if (win->suspensions) {
+                std::cout << "    suspended " << win->suspensions << " times, " << win->suspended_ns / 1000000
+                          << " ms in total\n";
+            }
+            win->protocol.dump(std::cout, "protocol", win->draw_us.count(), "frame");
+            win->fill_perf.dump(std::cout, "fill", win->draw_us.count(), "frame");
+            win->hash_perf.dump(std::cout, "hash", win->draw_us.count(), "frame");
+            if (win->draw_us.count()) {
+                std::cout << "    draw     p50 " << win->draw_us.percentile(50) << " us, p99 "
+                          << win->draw_us.percentile(99) << " us, max " << win->draw_us.max() << " us\n";
+            }
+            if (dynamic_scale && win->render_scale.budget_us()) {
+                std::cout << "    scale    " << win->render_scale.percent() << "% (frame "
+                          << win->render_scale.average_us() << " us, budget " << win->render_scale.budget_us()
+                          << " us), " << win->render_scale.downscales << " down, "
+                          << win->render_scale.upscales << " up\n";
+            }
+            if (win->frame_pixels) {
+                std::cout << "    damage   repainted " << std::fixed << std::setprecision(1)
+                          << 100.0 * win->repaint_pixels / win->frame_pixels << "% of pixels\n" << std::defaultfloat;
+            }
+            if (win->tiles_hashed) {
+                std::cout << "    tiles    " << std::fixed << std::setprecision(1)
+                          << 100.0 * win->tiles_changed / win->tiles_hashed << "% changed, "
+                          << win->hash_ns / win->tiles_hashed << " ns hashing per tile\n" << std::defaultfloat;
+            }
+            if (win->cache.enabled()) {
+                const BufferCache::Stats& cache = win->cache.stats();
+                std::cout << "    cache    " << cache.hits << " hits, " << cache.builds << " palettes rendered, "
+                          << cache.refusals << " did not fit, " << (win->cache.bytes() >> 20) << " MiB (all windows "
+                          << (cache_budget.used() >> 20) << " / " << (cache_budget.limit() >> 20) << " MiB)\n";
+            }
+        }
+        if (PROTOCOL_STATS) {
+            std::cout << "🔁 Main loop: " << loop_ticks << " ticks\n";
+            startup_protocol.dump(std::cout, "startup", 0, nullptr);
+            loop_protocol.dump(std::cout, "protocol", loop_ticks, "tick");
+        }
+        if (log_dropped()) {
+            std::cout << "⚠️  Log ring full " << log_dropped() << " times, records dropped\n";
+        }
+        std::cout << "==========================\n" << std::flush;
+    }
 
-        if (ftruncate(fd, size) == -1) {
-            perror("ftruncate");
-            close(fd);
+    // --trace: written on SIGUSR1 and on exit
+    void write_trace() {
+        if (!trace_enabled()) return;
+        long events = trace_write();
+        if (events < 0) {
+            LOG_ERROR << "❌ Could not write the trace: " << strerror(errno);
             return;
         }
+        LOG_INFO << "📝 Trace written: " << events << " events";
+    }
 
-        win.shm_data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-        if (win.shm_data == MAP_FAILED) {
-            perror("mmap");
-            close(fd);
+    bool create_buffer(Window& win) {
+        win.render_tasks.clear();
+        if (!prepare_buffer(win, win.render_tasks))
+            return false;
+        execute(win.render_tasks);
+        present_buffer(win);
+        return true;
+    }
+
+    // The shared pool is only driven from the main loop; window threads
+    // run their own tasks
+    void execute(std::vector<RenderTask>& tasks) {
+        if (!threaded) {
+            render_pool.run(tasks);
             return;
         }
+        for (auto& task : tasks) {
+            task.fn(task.ctx, task.begin, task.end);
+        }
+    }
 
-        struct wl_shm_pool* pool = wl_shm_create_pool(shm, fd, size);
-        win.buffer = wl_shm_pool_create_buffer(pool, 0, win.width, win.height, stride, BUFFER_FORMAT);
-        wl_shm_pool_destroy(pool);
-        close(fd);
+    // Draw and commit every window that wants a new frame and whose previous
+    // frame has been shown. Windows still waiting for their frame callback
+    // are drawn once it arrives, so each output runs at its own refresh rate.
+    // Each window's bands are one pool batch: every window still gets every
+    // thread, and its frame time covers its own work only.
+    void render_ready_windows() {
+        for (auto& window : windows) {
+            auto& win = *window;
+            sync_color(win);
+            sync_scale(win);
+            if (win.suspended || !win.needs_redraw || win.frame_callback || !win.configured)
+                continue;
+
+            uint64_t start = TimerQueue::now_ns();
+            ProtocolScope protocol_scope(win.protocol);
+            render_tasks.clear();
+            if (!prepare_buffer(win, render_tasks))
+                continue;
+            {
+                TraceSpan span("render", win.index);
+                render_pool.run(render_tasks);
+            }
+            TraceSpan span("commit", win.index);
+            present_buffer(win);
+            wl_surface_commit(win.surface);
+            protocol_request();
+            record_frame_time(win, (TimerQueue::now_ns() - start) / 1000);
+        }
+    }
 
-        // Fill buffer with assigned color
-        uint32_t* pixels = static_cast<uint32_t*>(win.shm_data);
-        for (int i = 0; i < win.width * win.height; ++i) {
-            pixels[i] = win.color;
+    // Render time of one frame. Under --dynamic-scale it drives the render
+    // scale, which resizes the buffer from the next frame on.
+    void record_frame_time(Window& win, uint64_t frame_us) {
+        win.draw_us.record(frame_us);
+        if (!dynamic_scale || !win.viewport || win.solid) return;
+
+        uint64_t budget = frame_budget_us;
+        int refresh_mhz = win.refresh_mhz.load(std::memory_order_relaxed);
+        if (!budget && refresh_mhz) {
+            budget = 1000000000ull / refresh_mhz * RENDER_BUDGET_PERCENT / 100;
+        }
+        win.render_scale.set_budget(budget);
+        if (win.render_scale.record(frame_us)) {
+            LOG_INFO << "📐 Window " << win.index+1 << ": render scale " << win.render_scale.percent()
+                     << "% (frame " << win.render_scale.average_us() << " us, budget " << budget << " us)";
+            update_buffer_size(win);
         }
+    }
 
-        // Attach and damage
-        wl_surface_attach(win.surface, win.buffer, 0, 0);
-        wl_surface_damage(win.surface, 0, 0, win.width, win.height);
+    static void color_tick(void* data) {
+        WaylandWindow* self = static_cast<WaylandWindow*>(data);
+        TraceSpan span("color tick");
+        uint64_t now = TimerQueue::now_ns();
+        self->next_color(now - self->last_color_tick);
+        self->last_color_tick = now;
+    }
+
+    void next_color(uint64_t elapsed_ns) {
+        double seconds = elapsed_ns / 1e9;
+        for (auto& win : windows) {
+            LOG_INFO << "🖥️  Window " << win->index+1 << ": " << win->frames.exchange(0) / seconds << " fps (output "
+                     << win->refresh_mhz.load(std::memory_order_relaxed) / 1000.0 << " Hz)";
+        }
 
-        // Frame callback for smooth presentation
-        struct wl_callback* frame_cb = wl_surface_frame(win.surface);
-        wl_callback_add_listener(frame_cb, &frame_listener_impl, this);
+        advance_colors(1);
+    }
+
+    void advance_colors(uint64_t steps) {
+        current_color_index.store((current_color_index.load() + steps) % NUM_COLORS, std::memory_order_release);
+        update_colors();
+        if (threaded) {
+            for (auto& win : windows) {
+                wake(win->wake_fd);
+            }
+        }
+    }
+
+    // Colors only change for someone to see them: with every window
+    // suspended the color timer is paused, and once one is shown again the
+    // steps it missed are applied at once, so it catches up in one frame
+    void sync_color_timer() {
+        bool visible = windows.empty();
+        for (auto& win : windows) {
+            if (!win->suspended.load(std::memory_order_relaxed)) visible = true;
+        }
+        if (visible != color_timer_paused) return;
+
+        color_timer_paused = !visible;
+        if (color_timer_paused) {
+            timers.pause(color_timer);
+            LOG_INFO << "💤 All windows suspended, color timer paused";
+            return;
+        }
+
+        uint64_t skipped = timers.resume(color_timer);
+        last_color_tick = TimerQueue::now_ns();
+        for (auto& win : windows) {
+            win->frames = 0;
+        }
+        if (skipped) advance_colors(skipped);
+    }
+
+    void set_animate(bool on) {
+        animate = on;
+    }
+
+    // Draw in this format if the compositor supports it
+    void set_format(PixelFormat f) {
+        use_format(f);
+        format_forced = true;
+    }
+
+    // Render at a lower resolution when frames take longer than budget_us
+    // (0: a share of the refresh interval)
+    void set_dynamic_scale(uint64_t budget_us) {
+        dynamic_scale = true;
+        frame_budget_us = budget_us;
+    }
+
+    // Hash tile rows as they are drawn and damage only the tiles that changed
+    void set_tile_damage(bool on) {
+        tile_damage = on;
+    }
+
+    // Must be called before initialize()
+    void set_threaded(bool on) {
+        threaded = on;
+    }
+
+    // Palette cache budget of all windows together; 0 disables the cache
+    void set_cache_budget(size_t bytes) {
+        cache_budget.set_limit(bytes);
+    }
+
+    // --bench-outputs: cost of driving 1..BENCH_MAX_OUTPUTS outputs, no
+    // compositor needed. One app, and so one render pool, serves every
+    // count. Windows draw into heap buffers. Allocation is timed on its own
+    // (window records, buffers and the first touch of every page), as is
+    // dispatch: the color sync, band split and pool hand-off of a frame with
+    // empty bands. Frames then run the same per-window pool fill as
+    // render_ready_windows(), so every per-output column should stay flat.
+    static int benchmark_outputs(int width, int height, int frames, PixelFormat format) {
+        size_t stride = static_cast<size_t>(width) * pixel_format_info(format).bytes;
+        size_t bytes = (stride * height + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+        long page = sysconf(_SC_PAGESIZE);
+
+        WaylandWindow app;
+        app.use_format(format);
+        app.windows.reserve(BENCH_MAX_OUTPUTS);
+
+        std::cout << "Output scaling at " << width << "x" << height << " " << pixel_format_info(format).name
+                  << ", " << frames << " frames each, kernel " << pixel_fill_kernel().name
+                  << ", render pool of " << app.render_pool.size() << "\n";
+        std::cout << "outputs  alloc ms/output  dispatch us/output  frame ms  fill ms/output     GB/s\n";
+        std::cout << std::fixed;
+
+        for (int count = 1; count <= BENCH_MAX_OUTPUTS; ++count) {
+            uint64_t start = TimerQueue::now_ns();
+            for (int i = 0; i < count; ++i) {
+                Window& win = app.add_window();
+                win.width = width;
+                win.height = height;
+                win.fill_spans.assign(1, { &win, 0, width });
+                win.configured = true;
+                win.shm_data = aligned_alloc(CACHE_LINE_SIZE, bytes);
+                if (!win.shm_data) {
+                    std::cerr << "❌ Out of memory at " << count << " outputs\n";
+                    return 1;
+                }
+                for (size_t offset = 0; offset < bytes; offset += page) {
+                    static_cast<char*>(win.shm_data)[offset] = 0;
+                }
+            }
+            uint64_t alloc_ns = TimerQueue::now_ns() - start;
+
+            start = TimerQueue::now_ns();
+            for (int frame = 0; frame < frames; ++frame) {
+                app.current_color_index.store((frame + 1) % NUM_COLORS);
+                app.render_frame(stride, skip_rows);
+            }
+            uint64_t dispatch_ns = TimerQueue::now_ns() - start;
+
+            start = TimerQueue::now_ns();
+            for (int frame = 0; frame < frames; ++frame) {
+                app.current_color_index.store((frame + 1) % NUM_COLORS);
+                app.render_frame(stride, app.fill_kernel);
+            }
+            double frame_ms = (TimerQueue::now_ns() - start) / 1e6 / frames;
+
+            std::cout << std::setw(7) << count << std::setprecision(3)
+                      << std::setw(17) << alloc_ns / 1e6 / count
+                      << std::setprecision(1) << std::setw(20) << static_cast<double>(dispatch_ns) / 1e3 / frames / count
+                      << std::setprecision(2) << std::setw(10) << frame_ms
+                      << std::setprecision(3) << std::setw(15) << frame_ms / count
+                      << std::setprecision(2) << std::setw(9) << stride * height * count / (frame_ms * 1e6) << "\n";
+
+            for (auto& win : app.windows) free(win->shm_data);
+            app.windows.clear();
+            app.next_window_index = 0;
+        }
+        std::cout << std::defaultfloat;
+        return 0;
+    }
+
+    static void skip_rows(void* ctx, size_t begin, size_t end) {}
+
+    // One frame of every window the way render_ready_windows() draws it:
+    // color sync, then one pool batch per window (benchmark only)
+    void render_frame(size_t stride, void (*fn)(void*, size_t, size_t)) {
+        for (auto& window : windows) {
+            Window& win = *window;
+            sync_color(win);
+            render_tasks.clear();
+            render_pool.split_rows(render_tasks, fn, &win.fill_spans[0], win.height, stride);
+            render_pool.run(render_tasks);
+        }
+    }
+
+    static void wake(int fd) {
+        if (fd == -1) return;
+        uint64_t one = 1;
+        ssize_t ignored = write(fd, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    // Ends the main loop, which then stops the window threads. Safe from
+    // any thread: the window list itself is only touched by the main thread.
+    void stop() {
+        running = false;
+        wake(wake_fd);
+    }
+
+    void start_thread(Window& win) {
+        win.thread = std::thread(&WaylandWindow::window_loop, this, std::ref(win));
     }
 
     void run() {
-        std::cout << "▶️ Running Wayland event loop... (close any window to exit)\n";
-        std::cout << "⏱️ Colors will change every 3 seconds.\n";
+        LOG_INFO << "▶️ Running Wayland event loop... (close any window to exit)";
+        LOG_INFO << "⏱️ Colors will change every 3 seconds.";
+        if (animate) {
+            LOG_INFO << "🎞️ Animating at each output's refresh rate.";
+        }
 
-        struct pollfd pfd = {};
-        pfd.fd = wl_display_get_fd(display);
-        pfd.events = POLLIN;
+        // Display events, timer expirations and SIGUSR1 wake the same poll()
+        struct pollfd pfds[4] = {};
+        pfds[0].fd = wl_display_get_fd(display);
+        pfds[0].events = POLLIN;
+        pfds[1].fd = timers.fd();
+        pfds[1].events = POLLIN;
+        pfds[2].fd = stats_pipe[0];
+        pfds[2].events = POLLIN;
+        pfds[3].fd = wake_fd;       // -1 (ignored) unless threaded
+        pfds[3].events = POLLIN;
+
+        last_color_tick = TimerQueue::now_ns();
+        color_timer = timers.add("color change", COLOR_INTERVAL_MS * 1000000ull, true, color_tick, this);
+
+        if (threaded) {
+            LOG_INFO << "🧵 One render thread per window, each with its own event queue";
+            for (auto& win : windows) {
+                start_thread(*win);
+            }
+        }
 
+        trace_thread_name("main loop");
+        ProtocolScope protocol_scope(loop_protocol);
         while (running) {
-            wl_display_dispatch_pending(display);
-            wl_display_flush(display);
+            loop_ticks++;
 
-            int ret = poll(&pfd, 1, 3000);
+            // Standard prepare/read cycle: nothing may be left queued before we sleep
+            while (wl_display_prepare_read(display) != 0) {
+                protocol_events(wl_display_dispatch_pending(display), loop_protocol);
+            }
+            {
+                TraceSpan span("wl_display_flush");
+                protocol_flush(display, loop_protocol);
+            }
+
+            int ret = poll(pfds, 4, -1);
+            trace_instant("wakeup");
 
             if (ret == -1) {
+                wl_display_cancel_read(display);
                 if (errno == EINTR) continue;
-                std::cerr << "❌ poll() failed: " << strerror(errno) << "\n";
+                LOG_ERROR << "❌ poll() failed: " << strerror(errno);
                 break;
             }
 
-            if (ret == 0) {
-                current_color_index = (current_color_index + 1) % NUM_COLORS;
-                update_colors();
-                for (int i = 0; i < 2; ++i) {
-                    create_buffer(i);
-                    wl_surface_commit(windows[i].surface);
+            if (pfds[0].revents & (POLLIN | POLLERR | POLLHUP)) {
+                if (protocol_read_events(display, loop_protocol) == -1) {
+                    LOG_ERROR << "❌ wl_display_read_events() failed";
+                    break;
                 }
-                wl_display_dispatch_pending(display);
             } else {
-                if (wl_display_dispatch(display) == -1) {
-                    std::cerr << "❌ wl_display_dispatch() failed\n";
+                wl_display_cancel_read(display);
+            }
+
+            if (protocol_events(wl_display_dispatch_pending(display), loop_protocol) == -1) {
+                LOG_ERROR << "❌ wl_display_dispatch_pending() failed";
+                break;
+            }
+
+            if (pfds[1].revents & POLLIN) {
+                timers.dispatch();
+            }
+
+            if (pfds[2].revents & POLLIN) {
+                char buf[16];
+                while (read(stats_pipe[0], buf, sizeof(buf)) > 0) {}
+                dump_stats();
+                write_trace();
+            }
+
+            if (pfds[3].revents & POLLIN) {
+                uint64_t ignored;
+                ssize_t n = read(wake_fd, &ignored, sizeof(ignored));
+                (void)n;
+            }
+
+            sync_color_timer();
+
+            if (!threaded) {
+                render_ready_windows();
+            }
+        }
+
+        stop();
+        for (auto& win : windows) {
+            wake(win->wake_fd);
+            if (win->thread.joinable()) win->thread.join();
+        }
+
+        log_flush();
+        timers.print_stats();
+        dump_stats();
+        write_trace();
+    }
+
+    // --threaded: dispatch and draw one window. All threads poll the same
+    // display fd; libwayland lets the last thread that prepared a read do
+    // it and then routes each event to its proxy's queue.
+    void window_loop(Window& win) {
+        struct pollfd pfds[2] = {};
+        pfds[0].fd = wl_display_get_fd(display);
+        pfds[0].events = POLLIN;
+        pfds[1].fd = win.wake_fd;
+        pfds[1].events = POLLIN;
+
+        char thread_name[32];
+        snprintf(thread_name, sizeof(thread_name), "window %d", win.index+1);
+        trace_thread_name(thread_name);
+
+        ProtocolScope protocol_scope(win.protocol);
+        while (running && !win.closing) {
+            while (wl_display_prepare_read_queue(display, win.queue) != 0) {
+                protocol_events(wl_display_dispatch_queue_pending(display, win.queue), win.protocol);
+            }
+            {
+                TraceSpan span("wl_display_flush", win.index);
+                protocol_flush(display, win.protocol);
+            }
+
+            int ret = poll(pfds, 2, -1);
+            trace_instant("wakeup", win.index);
+            if (ret == -1) {
+                wl_display_cancel_read(display);
+                if (errno == EINTR) continue;
+                LOG_ERROR << "❌ Window " << win.index+1 << ": poll() failed: " << strerror(errno);
+                break;
+            }
+
+            if (pfds[0].revents & (POLLIN | POLLERR | POLLHUP)) {
+                if (protocol_read_events(display, win.protocol) == -1) {
+                    LOG_ERROR << "❌ Window " << win.index+1 << ": wl_display_read_events() failed";
                     break;
                 }
+            } else {
+                wl_display_cancel_read(display);
+            }
+
+            if (protocol_events(wl_display_dispatch_queue_pending(display, win.queue), win.protocol) == -1) {
+                LOG_ERROR << "❌ Window " << win.index+1 << ": wl_display_dispatch_queue_pending() failed";
+                break;
+            }
+
+            if (pfds[1].revents & POLLIN) {
+                uint64_t ignored;
+                ssize_t n = read(win.wake_fd, &ignored, sizeof(ignored));
+                (void)n;
+            }
+
+            sync_color(win);
+            sync_scale(win);
+            if (win.suspended || !win.needs_redraw || win.frame_callback || !win.configured)
+                continue;
+
+            uint64_t start = TimerQueue::now_ns();
+            if (create_buffer(win)) {
+                TraceSpan span("commit", win.index);
+                wl_surface_commit(win.surface);
+                protocol_request();
+                record_frame_time(win, (TimerQueue::now_ns() - start) / 1000);
             }
         }
+
+        if (!win.closing) stop();
     }
 
 private:
@@ -396,12 +1927,28 @@ private:
         .scale = output_scale
     };
 
+    static constexpr zxdg_output_v1_listener xdg_output_listener_impl = {
+        .logical_position = xdg_output_logical_position,
+        .logical_size = xdg_output_logical_size,
+        .done = xdg_output_done,
+        .name = xdg_output_name,
+        .description = xdg_output_description
+    };
+
+    static constexpr wp_fractional_scale_v1_listener fractional_scale_listener_impl = {
+        .preferred_scale = fractional_preferred_scale
+    };
+
     // Registry listener
     static constexpr wl_registry_listener registry_listener_impl = {
         .global = registry_global,
         .global_remove = registry_global_remove
     };
 
+    static constexpr wl_shm_listener shm_listener_impl = {
+        .format = shm_format
+    };
+
     // WM base listener
     static constexpr xdg_wm_base_listener wm_base_listener_impl = {
         .ping = xdg_wm_base_ping
@@ -415,26 +1962,136 @@ private:
     // Toplevel listener
     static constexpr xdg_toplevel_listener xdg_toplevel_listener_impl = {
         .configure = xdg_toplevel_configure,
-        .close = xdg_toplevel_close
+        .close = xdg_toplevel_close,
+        .configure_bounds = xdg_toplevel_configure_bounds,
+        .wm_capabilities = xdg_toplevel_wm_capabilities
+    };
+
+    // Presentation listeners
+    static constexpr wp_presentation_listener presentation_listener_impl = {
+        .clock_id = presentation_clock_id
+    };
+
+    static constexpr wp_presentation_feedback_listener feedback_listener_impl = {
+        .sync_output = feedback_sync_output,
+        .presented = feedback_presented,
+        .discarded = feedback_discarded
     };
 
-    // Frame callback listener
-    static void frame_callback(void* data, struct wl_callback* callback, uint32_t time) {
+    // Frame callback: the previous frame of this window is on screen
+    static void frame_done(void* data, struct wl_callback* callback, uint32_t time) {
+        Window* win = static_cast<Window*>(data);
+        protocol_event(win->event_stats);
         wl_callback_destroy(callback);
+        win->frame_callback = nullptr;
+        win->frame_time = time;
+        trace_instant("frame callback", win->index);
+
+        // Animated content redraws on every frame, static content only on change
+        if (win->owner->animate) {
+            win->needs_redraw = true;
+        }
+    }
+
+    // Single-pixel buffers are kept for reuse; the release is only counted
+    static void solid_buffer_release(void* data, struct wl_buffer* buffer) {
+        protocol_event(static_cast<Window*>(data)->event_stats);
     }
 
+    static constexpr wl_buffer_listener solid_buffer_listener_impl = {
+        .release = solid_buffer_release
+    };
+
     static constexpr wl_callback_listener frame_listener_impl = {
-        .done = frame_callback
+        .done = frame_done
     };
 };
 
+int WaylandWindow::stats_pipe[2] = { -1, -1 };
+
 int main(int argc, char** argv) {
+    // --bench-fill [WIDTHxHEIGHT] [ITERATIONS]: time the fill kernels, no compositor needed
+    if (argc > 1 && std::strcmp(argv[1], "--bench-fill") == 0) {
+        int width = 7680, height = 4320, iterations = 30;
+        if (argc > 2) sscanf(argv[2], "%dx%d", &width, &height);
+        if (argc > 3) iterations = atoi(argv[3]);
+        return pixel_fill_benchmark(width, height, iterations > 0 ? iterations : 1);
+    }
+
+    pixel_fill_init();
+    tile_hash_init();
+
+    // --self-test: damage region and tile hash checks, no compositor needed
+    if (argc > 1 && std::strcmp(argv[1], "--self-test") == 0) {
+        int failures = 0;
+        if (!damage_self_test()) {
+            std::cout << "❌ Damage region has overlapping rectangles or lost pixels\n";
+            ++failures;
+        }
+        if (!tile_hash_self_test()) {
+            std::cout << "❌ Tile hash kernels disagree or miss a change\n";
+            ++failures;
+        }
+        if (!failures) std::cout << "✅ Self-test passed\n";
+        return failures ? 1 : 0;
+    }
+
+    // --bench-tiles [WIDTHxHEIGHT] [FRAMES]: tile hashing cost against the upload it saves
+    if (argc > 1 && std::strcmp(argv[1], "--bench-tiles") == 0) {
+        int width = 3840, height = 2160, frames = 60;
+        if (argc > 2) sscanf(argv[2], "%dx%d", &width, &height);
+        if (argc > 3) frames = atoi(argv[3]);
+        return tile_hash_benchmark(width, height, frames > 0 ? frames : 1);
+    }
+
+    // --bench-outputs [WIDTHxHEIGHT] [FRAMES] [FORMAT]: per-output cost from 1 to 16 outputs
+    if (argc > 1 && std::strcmp(argv[1], "--bench-outputs") == 0) {
+        int width = 1920, height = 1080, frames = 60;
+        PixelFormat format = PixelFormat::XRGB8888;
+        if (argc > 2) sscanf(argv[2], "%dx%d", &width, &height);
+        if (argc > 3) frames = atoi(argv[3]);
+        if (argc > 4 && !pixel_format_from_name(argv[4], format)) {
+            std::cerr << "❌ Unknown pixel format " << argv[4] << "\n";
+            return 1;
+        }
+        return WaylandWindow::benchmark_outputs(width, height, frames > 0 ? frames : 1, format);
+    }
+
     WaylandWindow window;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--animate") == 0) window.set_animate(true);
+        if (std::strcmp(argv[i], "--tile-damage") == 0) window.set_tile_damage(true);
+        if (std::strcmp(argv[i], "--dynamic-scale") == 0) window.set_dynamic_scale(0);
+        if (std::strcmp(argv[i], "--frame-budget-ms") == 0 && i + 1 < argc) {
+            window.set_dynamic_scale(static_cast<uint64_t>(std::max(0.0, atof(argv[++i])) * 1000));
+        }
+        if (std::strcmp(argv[i], "--threaded") == 0) window.set_threaded(true);
+        if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            // "auto" (the default) lets the compositor's formats and the palette decide
+            PixelFormat format;
+            const char* name = argv[++i];
+            if (pixel_format_from_name(name, format)) {
+                window.set_format(format);
+            } else if (std::strcmp(name, "auto") != 0) {
+                std::cerr << "❌ Unknown pixel format " << name << "\n";
+                return 1;
+            }
+        }
+        if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) trace_start(argv[++i]);
+        if (std::strcmp(argv[i], "--perf-counters") == 0) perf_start();
+        if (std::strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc) {
+            window.set_cache_budget(static_cast<size_t>(std::max(0, atoi(argv[++i]))) << 20);
+        }
+    }
 
+    // Window output goes through the asynchronous logger from here on
+    log_start();
     if (!window.initialize()) {
+        log_stop();
         return 1;
     }
 
     window.run();
+    log_stop();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,245 @@
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+// Bounded multi-producer ring (Vyukov): a slot's sequence number says
+// whether it is free for the producer at that position or holds a record
+// for the consumer, so producers only contend on the enqueue counter
+struct LogSlot {
+    std::atomic<uint64_t> sequence;
+    LogRecord record;
+};
+
+static LogSlot slots[LOG_RING_RECORDS];
+static std::atomic<uint64_t> enqueue_pos{0};
+static uint64_t dequeue_pos = 0;                 // Writer thread only
+static std::atomic<uint64_t> written{0};         // Records written out, for log_flush()
+static std::atomic<uint64_t> dropped{0};
+
+static std::thread writer;
+static std::atomic<bool> started{false};
+static std::atomic<bool> stopping{false};
+static std::atomic<bool> sleeping{false};        // Writer is (about to be) blocked on wake_fd
+static int wake_fd = -1;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static void write_all(int fd, const char* data, size_t length) {
+    while (length) {
+        ssize_t n = write(fd, data, length);
+        if (n <= 0) return;
+        data += n;
+        length -= n;
+    }
+}
+
+static int level_fd(LogLevel level) {
+    return level >= LogLevel::Warn ? STDERR_FILENO : STDOUT_FILENO;
+}
+
+// "[seconds.micros] text\n"; returns the length, buffer must hold LOG_TEXT_SIZE + 32
+static size_t format_record(const LogRecord& record, char* buffer) {
+    int prefix = snprintf(buffer, 32, "[%6llu.%06llu] ",
+                          static_cast<unsigned long long>(record.time_ns / 1000000000ull),
+                          static_cast<unsigned long long>(record.time_ns % 1000000000ull / 1000));
+    memcpy(buffer + prefix, record.text, record.length);
+    buffer[prefix + record.length] = '\n';
+    return prefix + record.length + 1;
+}
+
+static bool push(const LogRecord& record) {
+    uint64_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    LogSlot* slot;
+    for (;;) {
+        slot = &slots[pos & (LOG_RING_RECORDS - 1)];
+        int64_t diff = static_cast<int64_t>(slot->sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;                        // Full: the writer is a whole ring behind
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    size_t header = offsetof(LogRecord, text);
+    memcpy(&slot->record, &record, header + record.length);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    // Pairs with the fence in writer_loop(): either the writer sees this
+    // record before sleeping, or we see it sleeping and wake it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false)) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+    return true;
+}
+
+static bool pop(LogRecord& record) {
+    LogSlot& slot = slots[dequeue_pos & (LOG_RING_RECORDS - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) return false;
+    memcpy(&record, &slot.record, offsetof(LogRecord, text) + slot.record.length);
+    slot.sequence.store(dequeue_pos + LOG_RING_RECORDS, std::memory_order_release);
+    dequeue_pos++;
+    return true;
+}
+
+// Write out everything queued, batching consecutive stdout lines into one
+// write(); returns the number of records written
+static size_t drain() {
+    static char batch[64 * 1024];
+    static LogRecord record;
+    size_t length = 0, count = 0;
+    int batch_fd = STDOUT_FILENO;
+
+    while (pop(record)) {
+        int fd = level_fd(record.level);
+        if (length && (fd != batch_fd || length + LOG_TEXT_SIZE + 32 > sizeof(batch))) {
+            write_all(batch_fd, batch, length);
+            length = 0;
+        }
+        batch_fd = fd;
+        length += format_record(record, batch + length);
+        count++;
+    }
+    if (length) write_all(batch_fd, batch, length);
+    written.fetch_add(count, std::memory_order_release);
+    return count;
+}
+
+static void writer_loop() {
+    uint64_t reported = 0;
+    for (;;) {
+        drain();
+
+        uint64_t lost = dropped.load(std::memory_order_relaxed);
+        if (lost != reported) {
+            char line[96];
+            int n = snprintf(line, sizeof(line), "⚠️  Log ring full: %llu records dropped\n",
+                             static_cast<unsigned long long>(lost - reported));
+            write_all(STDERR_FILENO, line, n);
+            reported = lost;
+        }
+
+        if (stopping.load(std::memory_order_acquire)) {
+            if (drain() == 0) return;
+            continue;
+        }
+
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        LogSlot& next = slots[dequeue_pos & (LOG_RING_RECORDS - 1)];
+        if (next.sequence.load(std::memory_order_acquire) == dequeue_pos + 1 || stopping.load()) {
+            sleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+        uint64_t ignored;
+        ssize_t n = read(wake_fd, &ignored, sizeof(ignored));
+        (void)n;
+    }
+}
+
+bool log_start() {
+    if (started) return true;
+    for (uint64_t i = 0; i < LOG_RING_RECORDS; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    enqueue_pos = 0;
+    dequeue_pos = 0;
+    written = 0;
+
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (wake_fd == -1) {
+        perror("eventfd");
+        return false;
+    }
+    stopping = false;
+    writer = std::thread(writer_loop);
+    started = true;
+    return true;
+}
+
+void log_stop() {
+    if (!started) return;
+    started = false;                             // Later lines are written synchronously
+    stopping.store(true, std::memory_order_release);
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+    writer.join();
+    close(wake_fd);
+    wake_fd = -1;
+}
+
+// Records are written in ring order and dropped ones never claim a
+// position, so everything pushed before the call is out once the writer
+// reaches the current enqueue position
+void log_flush() {
+    if (!started) return;
+    uint64_t target = enqueue_pos.load(std::memory_order_acquire);
+    while (written.load(std::memory_order_acquire) < target) {
+        usleep(1000);
+    }
+}
+
+uint64_t log_dropped() {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+LogLine::LogLine(LogLevel level) {
+    record_.time_ns = now_ns();
+    record_.length = 0;
+    record_.level = level;
+}
+
+LogLine::~LogLine() {
+    if (started.load(std::memory_order_acquire)) {
+        if (!push(record_)) dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    char line[LOG_TEXT_SIZE + 32];
+    write_all(level_fd(record_.level), line, format_record(record_, line));
+}
+
+void LogLine::append(const char* text, size_t length) {
+    length = std::min(length, static_cast<size_t>(LOG_TEXT_SIZE - record_.length));
+    memcpy(record_.text + record_.length, text, length);
+    record_.length += length;
+}
+
+LogLine& LogLine::operator<<(const char* text) {
+    append(text, strlen(text));
+    return *this;
+}
+
+LogLine& LogLine::operator<<(long long value) {
+    char digits[24];
+    append(digits, snprintf(digits, sizeof(digits), "%lld", value));
+    return *this;
+}
+
+LogLine& LogLine::operator<<(unsigned long long value) {
+    char digits[24];
+    append(digits, snprintf(digits, sizeof(digits), "%llu", value));
+    return *this;
+}
+
+// Same as an ostream's default: six significant digits
+LogLine& LogLine::operator<<(double value) {
+    char digits[32];
+    append(digits, snprintf(digits, sizeof(digits), "%g", value));
+    return *this;
+}
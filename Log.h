@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Asynchronous logger for the event loop and render threads. A log line is
+// formatted into a fixed-size record on the caller's stack and copied into
+// a lock-free ring; a background thread writes the ring out, so a slow
+// stdout (a pipe to journald) never blocks dispatch, pongs or commits.
+// Nothing on the logging path allocates, locks or makes a blocking call.
+// When the ring is full the record is dropped and counted.
+//
+//     LOG_INFO << "🎯 Window " << index << " assigned";
+//
+// Levels below LOG_LEVEL are compiled out: build with
+// -DLOG_LEVEL=LOG_LEVEL_WARN to drop every info line including the
+// formatting of its arguments. Warnings and errors go to stderr, the rest
+// to stdout. Before log_start() and after log_stop() lines are written
+// synchronously.
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_RECORDS 1024    // Power of two
+#define LOG_TEXT_SIZE 240        // Longer lines are truncated
+
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error };
+
+struct LogRecord {
+    uint64_t time_ns;            // CLOCK_MONOTONIC
+    uint16_t length;
+    LogLevel level;
+    char text[LOG_TEXT_SIZE];
+};
+
+// One line; published when it goes out of scope
+class LogLine {
+public:
+    explicit LogLine(LogLevel level);
+    ~LogLine();
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    LogLine& operator<<(const char* text);
+    LogLine& operator<<(const std::string& text) { append(text.data(), text.size()); return *this; }
+    LogLine& operator<<(char c) { append(&c, 1); return *this; }
+    LogLine& operator<<(int value) { return *this << static_cast<long long>(value); }
+    LogLine& operator<<(unsigned value) { return *this << static_cast<unsigned long long>(value); }
+    LogLine& operator<<(long value) { return *this << static_cast<long long>(value); }
+    LogLine& operator<<(unsigned long value) { return *this << static_cast<unsigned long long>(value); }
+    LogLine& operator<<(long long value);
+    LogLine& operator<<(unsigned long long value);
+    LogLine& operator<<(double value);
+
+private:
+    void append(const char* text, size_t length);
+
+    LogRecord record_;
+};
+
+#define LOG_AT(level, name) if (LOG_LEVEL > LOG_LEVEL_##level) {} else LogLine(LogLevel::name)
+#define LOG_DEBUG LOG_AT(DEBUG, Debug)
+#define LOG_INFO LOG_AT(INFO, Info)
+#define LOG_WARN LOG_AT(WARN, Warn)
+#define LOG_ERROR LOG_AT(ERROR, Error)
+
+// Start the writer thread. Returns false (and keeps logging synchronously)
+// if it cannot be started.
+bool log_start();
+
+// Write out everything queued and stop the writer thread
+void log_stop();
+
+// Wait until everything logged so far has been written, e.g. before a
+// report printed straight to std::cout. Not for the hot path.
+void log_flush();
+
+// Records lost to a full ring
+uint64_t log_dropped();
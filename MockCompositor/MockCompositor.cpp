@@ -0,0 +1,1207 @@
+// Stand-in compositor for measuring GuiTest headless and repeatably. It
+// implements just enough of the protocol for the client to run: a
+// configurable set of wl_outputs that tick at their refresh rate, wl_shm
+// (pools are mapped so their size can be accounted), xdg_wm_base with
+// fullscreen toplevels, and optionally wp_viewporter and wp_presentation.
+// Nothing is drawn; a committed buffer is "presented" on the next tick of
+// its output.
+//
+// A protocol logger counts every request, event, fd and roundtrip; once a
+// second the counts and the bytes the client had mapped for buffers are
+// printed per client frame (commit with a buffer), along with its RSS.
+// Latency can be injected after every dispatch, and configure storms and
+// output hotplugs can be generated, to see what they cost the client.
+//
+// The extension glue is the server side of the protocol code the client
+// is built with. Its headers are wayland-scanner server-header output;
+// run generate-protocol.sh once before building.
+//
+//     MockCompositor --outputs 2 --mode 3840x2160@60 -- ./GuiTest --animate
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+extern "C" {
+#include <wayland-server.h>
+#include "xdg-shell-server-protocol.h"
+#include "presentation-time-server-protocol.h"
+#include "viewporter-server-protocol.h"
+}
+
+#define XDG_WM_BASE_VERSION 6
+
+#define REPORT_INTERVAL_MS 1000
+#define RESIZE_STORM_SHRINK 64   // Logical pixels taken off every other --resize-storm configure
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+struct Mode {
+    int width = 1920, height = 1080;
+    int refresh_mhz = 60000;
+};
+
+struct Options {
+    int outputs = 2;
+    std::vector<Mode> modes;          // Per output; the last one repeats
+    int scale = 1;
+    bool viewporter = true;
+    bool presentation = true;
+    int latency_ms = 0;               // Stall after every dispatch
+    int configure_storm_hz = 0;       // Unsolicited configures per second
+    bool resize_storm = false;        // ... alternating between two sizes
+    int hotplug_ms = 0;               // Unplug the last output, plug it back after as long
+    int duration_s = 0;               // 0: until the client exits or SIGINT
+    char** command = nullptr;         // Client to start, after "--"
+};
+
+struct Compositor;
+struct Surface;
+
+struct Output {
+    Compositor* compositor = nullptr;
+    int index = 0;
+    Mode mode;
+    int x = 0;                        // Position in the logical layout
+    struct wl_global* global = nullptr;
+    bool connected = true;
+    std::vector<struct wl_resource*> resources;     // Bound to the current global
+
+    // Simulated vblank
+    struct wl_event_source* timer = nullptr;
+    uint64_t period_ns = 0;
+    uint64_t next_ns = 0;
+    uint64_t msc = 0;
+    uint64_t missed = 0;              // Ticks the event loop was too late for
+};
+
+// Client memory mapped for wl_shm; buffers keep it alive after the pool
+// object is destroyed
+struct Pool {
+    Compositor* compositor = nullptr;
+    void* data = nullptr;
+    int32_t size = 0;
+    int refs = 1;
+};
+
+struct Buffer {
+    Pool* pool = nullptr;
+    struct wl_resource* resource = nullptr;
+    int32_t width = 0, height = 0;
+    Surface* pending_on = nullptr;    // Attached, not yet committed
+    Surface* current_on = nullptr;    // Committed: released by the next commit
+};
+
+struct Surface {
+    Compositor* compositor = nullptr;
+    struct wl_resource* resource = nullptr;
+    Buffer* pending = nullptr;
+    bool attached = false;
+    Buffer* current = nullptr;
+    std::vector<struct wl_resource*> pending_frames, frames;
+    std::vector<struct wl_resource*> pending_feedbacks, feedbacks;
+
+    struct wl_resource* xdg_surface = nullptr;
+    struct wl_resource* xdg_toplevel = nullptr;
+    int output = 0;                   // Output it is shown on
+    bool fullscreen = false;
+    bool configured = false;          // Initial configure sent
+    bool entered = false;
+    bool drawn = false;               // First buffer committed
+};
+
+struct Counters {
+    uint64_t requests = 0;
+    uint64_t events = 0;
+    uint64_t fds = 0;
+    uint64_t roundtrips = 0;
+    uint64_t frames = 0;              // Commits with a buffer
+    uint64_t configures = 0;
+    uint64_t acks = 0;
+    uint64_t mapped = 0;              // Bytes of new pools and pool growth
+};
+
+struct Compositor {
+    Options options;
+    struct wl_display* display = nullptr;
+    struct wl_event_loop* loop = nullptr;
+    const char* socket = nullptr;
+    std::vector<std::unique_ptr<Output>> outputs;
+    std::vector<Surface*> surfaces;
+    std::vector<struct wl_resource*> wm_bases;
+    bool running = true;
+
+    Counters total, reported;
+    uint64_t mapped_bytes = 0, peak_mapped_bytes = 0;     // Held by live pools
+    uint64_t pools = 0, buffers = 0;
+
+    uint64_t first_client_ns = 0;
+    uint64_t startup_ns = 0;          // First client connect to every toplevel drawn
+    pid_t child = -1;
+    pid_t client_pid = 0;
+    long rss_first_kb = -1, rss_peak_kb = 0;
+
+    uint32_t ping_serial = 0;
+    uint64_t ping_sent_ns = 0;
+    uint64_t pong_ns = 0, pong_max_ns = 0;
+
+    bool storm_small = false;
+    uint64_t hotplugs = 0;
+    struct wl_event_source* report_timer = nullptr;
+    struct wl_event_source* storm_timer = nullptr;
+    struct wl_event_source* hotplug_timer = nullptr;
+    struct wl_event_source* duration_timer = nullptr;
+    struct wl_listener client_created;
+};
+
+static void destroy_resource(struct wl_client* client, struct wl_resource* resource) {
+    wl_resource_destroy(resource);
+}
+
+static void remove_resource(std::vector<struct wl_resource*>& list, struct wl_resource* resource) {
+    list.erase(std::remove(list.begin(), list.end(), resource), list.end());
+}
+
+// Resource of the client's wl_output bound to out, null if it bound none
+static struct wl_resource* client_output(Output& out, struct wl_client* client) {
+    for (struct wl_resource* resource : out.resources) {
+        if (wl_resource_get_client(resource) == client) return resource;
+    }
+    return nullptr;
+}
+
+static long read_rss_kb(pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/status", static_cast<int>(pid));
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    char line[256];
+    long rss = -1;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "VmRSS: %ld kB", &rss) == 1) break;
+    }
+    fclose(file);
+    return rss;
+}
+
+// ---- Protocol traffic ----
+
+static void protocol_logger(void* data, enum wl_protocol_logger_type type,
+                            const struct wl_protocol_logger_message* message) {
+    Compositor* c = static_cast<Compositor*>(data);
+    if (type == WL_PROTOCOL_LOGGER_EVENT) {
+        c->total.events++;
+        return;
+    }
+    c->total.requests++;
+    for (const char* arg = message->message->signature; *arg; ++arg) {
+        if (*arg == 'h') c->total.fds++;
+    }
+    if (message->message_opcode == 0 && std::strcmp(wl_resource_get_class(message->resource), "wl_display") == 0) {
+        c->total.roundtrips++;   // wl_display.sync
+    }
+}
+
+// ---- wl_shm ----
+
+static void pool_unref(Pool* pool) {
+    if (--pool->refs > 0) return;
+    munmap(pool->data, pool->size);
+    pool->compositor->mapped_bytes -= pool->size;
+    pool->compositor->pools--;
+    delete pool;
+}
+
+static void buffer_destroyed(struct wl_resource* resource) {
+    Buffer* buffer = static_cast<Buffer*>(wl_resource_get_user_data(resource));
+    if (buffer->pending_on) buffer->pending_on->pending = nullptr;
+    if (buffer->current_on) buffer->current_on->current = nullptr;
+    buffer->pool->compositor->buffers--;
+    pool_unref(buffer->pool);
+    delete buffer;
+}
+
+static const struct wl_buffer_interface buffer_impl = {
+    .destroy = destroy_resource
+};
+
+static void pool_create_buffer(struct wl_client* client, struct wl_resource* resource, uint32_t id,
+                               int32_t offset, int32_t width, int32_t height, int32_t stride, uint32_t format) {
+    Pool* pool = static_cast<Pool*>(wl_resource_get_user_data(resource));
+    if (width <= 0 || height <= 0 || stride < width || offset < 0 ||
+        static_cast<int64_t>(offset) + static_cast<int64_t>(stride) * height > pool->size) {
+        wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_STRIDE, "buffer %dx%d stride %d offset %d "
+                               "outside the %d byte pool", width, height, stride, offset, pool->size);
+        return;
+    }
+
+    Buffer* buffer = new Buffer;
+    buffer->pool = pool;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->resource = wl_resource_create(client, &wl_buffer_interface, 1, id);
+    if (!buffer->resource) {
+        delete buffer;
+        wl_client_post_no_memory(client);
+        return;
+    }
+    pool->refs++;
+    pool->compositor->buffers++;
+    wl_resource_set_implementation(buffer->resource, &buffer_impl, buffer, buffer_destroyed);
+}
+
+static void pool_resize(struct wl_client* client, struct wl_resource* resource, int32_t size) {
+    Pool* pool = static_cast<Pool*>(wl_resource_get_user_data(resource));
+    if (size < pool->size) {
+        wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_FD, "pools can only grow");
+        return;
+    }
+    void* data = mremap(pool->data, pool->size, size, MREMAP_MAYMOVE);
+    if (data == MAP_FAILED) {
+        wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_FD, "mremap failed: %s", strerror(errno));
+        return;
+    }
+    Compositor* c = pool->compositor;
+    c->total.mapped += size - pool->size;
+    c->mapped_bytes += size - pool->size;
+    c->peak_mapped_bytes = std::max(c->peak_mapped_bytes, c->mapped_bytes);
+    pool->data = data;
+    pool->size = size;
+}
+
+static void pool_destroyed(struct wl_resource* resource) {
+    pool_unref(static_cast<Pool*>(wl_resource_get_user_data(resource)));
+}
+
+static const struct wl_shm_pool_interface pool_impl = {
+    .create_buffer = pool_create_buffer,
+    .destroy = destroy_resource,
+    .resize = pool_resize
+};
+
+static void shm_create_pool(struct wl_client* client, struct wl_resource* resource, uint32_t id,
+                            int32_t fd, int32_t size) {
+    Compositor* c = static_cast<Compositor*>(wl_resource_get_user_data(resource));
+    void* data = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) {
+        wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_FD, "cannot map %d byte pool", size);
+        return;
+    }
+
+    Pool* pool = new Pool;
+    pool->compositor = c;
+    pool->data = data;
+    pool->size = size;
+    struct wl_resource* pool_resource = wl_resource_create(client, &wl_shm_pool_interface,
+                                                           wl_resource_get_version(resource), id);
+    if (!pool_resource) {
+        munmap(data, size);
+        delete pool;
+        wl_client_post_no_memory(client);
+        return;
+    }
+    c->pools++;
+    c->total.mapped += size;
+    c->mapped_bytes += size;
+    c->peak_mapped_bytes = std::max(c->peak_mapped_bytes, c->mapped_bytes);
+    wl_resource_set_implementation(pool_resource, &pool_impl, pool, pool_destroyed);
+}
+
+static const struct wl_shm_interface shm_impl = {
+    .create_pool = shm_create_pool
+};
+
+static void shm_bind(struct wl_client* client, void* data, uint32_t version, uint32_t id) {
+    struct wl_resource* resource = wl_resource_create(client, &wl_shm_interface, 1, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &shm_impl, data, nullptr);
+    static const uint32_t formats[] = {
+        WL_SHM_FORMAT_ARGB8888, WL_SHM_FORMAT_XRGB8888, WL_SHM_FORMAT_RGB565, WL_SHM_FORMAT_XRGB2101010
+    };
+    for (uint32_t format : formats) {
+        wl_shm_send_format(resource, format);
+    }
+}
+
+// ---- wl_output ----
+
+static void output_release(struct wl_client* client, struct wl_resource* resource) {
+    wl_resource_destroy(resource);
+}
+
+static const struct wl_output_interface output_impl = {
+    .release = output_release
+};
+
+static void output_destroyed(struct wl_resource* resource) {
+    Output* out = static_cast<Output*>(wl_resource_get_user_data(resource));
+    if (out) remove_resource(out->resources, resource);
+}
+
+static void output_bind(struct wl_client* client, void* data, uint32_t version, uint32_t id) {
+    Output* out = static_cast<Output*>(data);
+    struct wl_resource* resource = wl_resource_create(client, &wl_output_interface, std::min(version, 4u), id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &output_impl, out, output_destroyed);
+    out->resources.push_back(resource);
+
+    char model[32];
+    snprintf(model, sizeof(model), "Output %d", out->index + 1);
+    wl_output_send_geometry(resource, out->x, 0, out->mode.width / 4, out->mode.height / 4,
+                            WL_OUTPUT_SUBPIXEL_UNKNOWN, "Mock", model, WL_OUTPUT_TRANSFORM_NORMAL);
+    wl_output_send_mode(resource, WL_OUTPUT_MODE_CURRENT | WL_OUTPUT_MODE_PREFERRED,
+                        out->mode.width, out->mode.height, out->mode.refresh_mhz);
+    if (version >= 2) wl_output_send_scale(resource, out->compositor->options.scale);
+    if (version >= 4) {
+        char name[32];
+        snprintf(name, sizeof(name), "MOCK-%d", out->index + 1);
+        wl_output_send_name(resource, name);
+        wl_output_send_description(resource, model);
+    }
+    if (version >= 2) wl_output_send_done(resource);
+}
+
+// ---- wl_surface ----
+
+static void frame_destroyed(struct wl_resource* resource) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    if (!surface) return;
+    remove_resource(surface->pending_frames, resource);
+    remove_resource(surface->frames, resource);
+}
+
+static void feedback_destroyed(struct wl_resource* resource) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    if (!surface) return;
+    remove_resource(surface->pending_feedbacks, resource);
+    remove_resource(surface->feedbacks, resource);
+}
+
+// Destroy resources held in a list without their destroy handlers
+// touching the list
+static void detach_all(std::vector<struct wl_resource*>& list, std::vector<struct wl_resource*>& out) {
+    for (struct wl_resource* resource : list) {
+        wl_resource_set_user_data(resource, nullptr);
+        out.push_back(resource);
+    }
+    list.clear();
+}
+
+static void surface_attach(struct wl_client* client, struct wl_resource* resource,
+                           struct wl_resource* buffer_resource, int32_t x, int32_t y) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    if (surface->pending) surface->pending->pending_on = nullptr;
+    surface->pending = buffer_resource ? static_cast<Buffer*>(wl_resource_get_user_data(buffer_resource)) : nullptr;
+    if (surface->pending) surface->pending->pending_on = surface;
+    surface->attached = true;
+}
+
+static void surface_damage(struct wl_client* client, struct wl_resource* resource,
+                           int32_t x, int32_t y, int32_t width, int32_t height) {
+}
+
+static void surface_frame(struct wl_client* client, struct wl_resource* resource, uint32_t id) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    struct wl_resource* callback = wl_resource_create(client, &wl_callback_interface, 1, id);
+    if (!callback) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(callback, nullptr, surface, frame_destroyed);
+    surface->pending_frames.push_back(callback);
+}
+
+static void surface_set_region(struct wl_client* client, struct wl_resource* resource,
+                               struct wl_resource* region) {
+}
+
+static void send_configure(Surface& surface);
+static void surface_drawn(Surface& surface);
+
+static void surface_commit(struct wl_client* client, struct wl_resource* resource) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+
+    if (surface->attached) {
+        Buffer* buffer = surface->pending;
+        surface->pending = nullptr;
+        surface->attached = false;
+        if (buffer) buffer->pending_on = nullptr;
+
+        // Contents are taken at commit, as by a compositor that uploads shm
+        if (surface->current && surface->current != buffer) {
+            surface->current->current_on = nullptr;
+            wl_buffer_send_release(surface->current->resource);
+        }
+        surface->current = buffer;
+        if (buffer) {
+            buffer->current_on = surface;
+            surface->compositor->total.frames++;
+            surface_drawn(*surface);
+        }
+    }
+
+    surface->frames.insert(surface->frames.end(), surface->pending_frames.begin(), surface->pending_frames.end());
+    surface->pending_frames.clear();
+
+    // A commit before the previous one was presented replaces it
+    std::vector<struct wl_resource*> discarded;
+    detach_all(surface->feedbacks, discarded);
+    for (struct wl_resource* feedback : discarded) {
+        wp_presentation_feedback_send_discarded(feedback);
+        wl_resource_destroy(feedback);
+    }
+    surface->feedbacks.swap(surface->pending_feedbacks);
+
+    if (surface->xdg_toplevel && !surface->configured) send_configure(*surface);
+}
+
+static void surface_set_int(struct wl_client* client, struct wl_resource* resource, int32_t value) {
+}
+
+static const struct wl_surface_interface surface_impl = {
+    .destroy = destroy_resource,
+    .attach = surface_attach,
+    .damage = surface_damage,
+    .frame = surface_frame,
+    .set_opaque_region = surface_set_region,
+    .set_input_region = surface_set_region,
+    .commit = surface_commit,
+    .set_buffer_transform = surface_set_int,
+    .set_buffer_scale = surface_set_int,
+    .damage_buffer = surface_damage
+};
+
+static void surface_destroyed(struct wl_resource* resource) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    if (surface->pending) surface->pending->pending_on = nullptr;
+    if (surface->current) surface->current->current_on = nullptr;
+    std::vector<struct wl_resource*> orphans;
+    detach_all(surface->pending_frames, orphans);
+    detach_all(surface->frames, orphans);
+    detach_all(surface->pending_feedbacks, orphans);
+    detach_all(surface->feedbacks, orphans);
+    if (surface->xdg_surface) wl_resource_set_user_data(surface->xdg_surface, nullptr);
+    if (surface->xdg_toplevel) wl_resource_set_user_data(surface->xdg_toplevel, nullptr);
+
+    auto& surfaces = surface->compositor->surfaces;
+    surfaces.erase(std::remove(surfaces.begin(), surfaces.end(), surface), surfaces.end());
+    delete surface;
+}
+
+// ---- wl_region, wl_compositor ----
+
+static void region_edit(struct wl_client* client, struct wl_resource* resource,
+                        int32_t x, int32_t y, int32_t width, int32_t height) {
+}
+
+static const struct wl_region_interface region_impl = {
+    .destroy = destroy_resource,
+    .add = region_edit,
+    .subtract = region_edit
+};
+
+static void compositor_create_surface(struct wl_client* client, struct wl_resource* resource, uint32_t id) {
+    Compositor* c = static_cast<Compositor*>(wl_resource_get_user_data(resource));
+    Surface* surface = new Surface;
+    surface->compositor = c;
+    surface->resource = wl_resource_create(client, &wl_surface_interface, wl_resource_get_version(resource), id);
+    if (!surface->resource) {
+        delete surface;
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(surface->resource, &surface_impl, surface, surface_destroyed);
+    c->surfaces.push_back(surface);
+}
+
+static void compositor_create_region(struct wl_client* client, struct wl_resource* resource, uint32_t id) {
+    struct wl_resource* region = wl_resource_create(client, &wl_region_interface, 1, id);
+    if (!region) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(region, &region_impl, nullptr, nullptr);
+}
+
+static const struct wl_compositor_interface compositor_impl = {
+    .create_surface = compositor_create_surface,
+    .create_region = compositor_create_region
+};
+
+static void compositor_bind(struct wl_client* client, void* data, uint32_t version, uint32_t id) {
+    struct wl_resource* resource = wl_resource_create(client, &wl_compositor_interface, std::min(version, 4u), id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &compositor_impl, data, nullptr);
+}
+
+// ---- xdg_wm_base ----
+
+// Size of a toplevel on its output, in surface coordinates
+static void toplevel_size(Surface& surface, int& width, int& height) {
+    Compositor* c = surface.compositor;
+    const Mode& mode = c->outputs[surface.output]->mode;
+    width = mode.width / c->options.scale;
+    height = mode.height / c->options.scale;
+    if (c->storm_small) {
+        width -= RESIZE_STORM_SHRINK;
+        height -= RESIZE_STORM_SHRINK;
+    }
+}
+
+static void send_configure(Surface& surface) {
+    Compositor* c = surface.compositor;
+    int version = wl_resource_get_version(surface.xdg_toplevel);
+    int width, height;
+    toplevel_size(surface, width, height);
+
+    struct wl_array states;
+    wl_array_init(&states);
+    if (!surface.configured && version >= XDG_TOPLEVEL_WM_CAPABILITIES_SINCE_VERSION) {
+        xdg_toplevel_send_wm_capabilities(surface.xdg_toplevel, &states);
+    }
+    if (version >= XDG_TOPLEVEL_CONFIGURE_BOUNDS_SINCE_VERSION) {
+        xdg_toplevel_send_configure_bounds(surface.xdg_toplevel, width, height);
+    }
+
+    uint32_t* state = static_cast<uint32_t*>(wl_array_add(&states, sizeof(uint32_t)));
+    if (state) *state = XDG_TOPLEVEL_STATE_ACTIVATED;
+    if (surface.fullscreen) {
+        state = static_cast<uint32_t*>(wl_array_add(&states, sizeof(uint32_t)));
+        if (state) *state = XDG_TOPLEVEL_STATE_FULLSCREEN;
+    }
+    xdg_toplevel_send_configure(surface.xdg_toplevel, width, height, &states);
+    wl_array_release(&states);
+
+    xdg_surface_send_configure(surface.xdg_surface, wl_display_next_serial(c->display));
+    surface.configured = true;
+    c->total.configures++;
+}
+
+static void toplevel_noop(struct wl_client* client, struct wl_resource* resource) {
+}
+
+static void toplevel_set_object(struct wl_client* client, struct wl_resource* resource, struct wl_resource* object) {
+}
+
+static void toplevel_set_string(struct wl_client* client, struct wl_resource* resource, const char* value) {
+}
+
+static void toplevel_show_window_menu(struct wl_client* client, struct wl_resource* resource,
+                                      struct wl_resource* seat, uint32_t serial, int32_t x, int32_t y) {
+}
+
+static void toplevel_move(struct wl_client* client, struct wl_resource* resource,
+                          struct wl_resource* seat, uint32_t serial) {
+}
+
+static void toplevel_resize(struct wl_client* client, struct wl_resource* resource,
+                            struct wl_resource* seat, uint32_t serial, uint32_t edges) {
+}
+
+static void toplevel_set_size(struct wl_client* client, struct wl_resource* resource, int32_t width, int32_t height) {
+}
+
+static void toplevel_set_fullscreen(struct wl_client* client, struct wl_resource* resource,
+                                    struct wl_resource* output) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    if (!surface) return;
+    surface->fullscreen = true;
+    Output* out = output ? static_cast<Output*>(wl_resource_get_user_data(output)) : nullptr;
+    if (out) surface->output = out->index;      // Null once unplugged
+    if (surface->configured) send_configure(*surface);
+}
+
+static void toplevel_unset_fullscreen(struct wl_client* client, struct wl_resource* resource) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    if (!surface) return;
+    surface->fullscreen = false;
+    if (surface->configured) send_configure(*surface);
+}
+
+static const struct xdg_toplevel_interface toplevel_impl = {
+    .destroy = destroy_resource,
+    .set_parent = toplevel_set_object,
+    .set_title = toplevel_set_string,
+    .set_app_id = toplevel_set_string,
+    .show_window_menu = toplevel_show_window_menu,
+    .move = toplevel_move,
+    .resize = toplevel_resize,
+    .set_max_size = toplevel_set_size,
+    .set_min_size = toplevel_set_size,
+    .set_maximized = toplevel_noop,
+    .unset_maximized = toplevel_noop,
+    .set_fullscreen = toplevel_set_fullscreen,
+    .unset_fullscreen = toplevel_unset_fullscreen,
+    .set_minimized = toplevel_noop
+};
+
+static void toplevel_destroyed(struct wl_resource* resource) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    if (surface) surface->xdg_toplevel = nullptr;
+}
+
+static void xdg_surface_get_toplevel(struct wl_client* client, struct wl_resource* resource, uint32_t id) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    struct wl_resource* toplevel = wl_resource_create(client, &xdg_toplevel_interface,
+                                                      wl_resource_get_version(resource), id);
+    if (!toplevel) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(toplevel, &toplevel_impl, surface, toplevel_destroyed);
+    if (surface) surface->xdg_toplevel = toplevel;
+}
+
+static void xdg_surface_get_popup(struct wl_client* client, struct wl_resource* resource, uint32_t id,
+                                  struct wl_resource* parent, struct wl_resource* positioner) {
+    wl_resource_post_error(resource, XDG_SURFACE_ERROR_NOT_CONSTRUCTED, "popups are not supported by the mock compositor");
+}
+
+static void xdg_surface_set_window_geometry(struct wl_client* client, struct wl_resource* resource,
+                                            int32_t x, int32_t y, int32_t width, int32_t height) {
+}
+
+static void xdg_surface_ack_configure(struct wl_client* client, struct wl_resource* resource, uint32_t serial) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    if (surface) surface->compositor->total.acks++;
+}
+
+static const struct xdg_surface_interface xdg_surface_impl = {
+    .destroy = destroy_resource,
+    .get_toplevel = xdg_surface_get_toplevel,
+    .get_popup = xdg_surface_get_popup,
+    .set_window_geometry = xdg_surface_set_window_geometry,
+    .ack_configure = xdg_surface_ack_configure
+};
+
+static void xdg_surface_destroyed(struct wl_resource* resource) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+    if (surface) surface->xdg_surface = nullptr;
+}
+
+static void wm_base_create_positioner(struct wl_client* client, struct wl_resource* resource, uint32_t id) {
+    wl_resource_post_error(resource, XDG_WM_BASE_ERROR_ROLE, "positioners are not supported by the mock compositor");
+}
+
+static void wm_base_get_xdg_surface(struct wl_client* client, struct wl_resource* resource, uint32_t id,
+                                    struct wl_resource* surface_resource) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(surface_resource));
+    struct wl_resource* xdg_surface = wl_resource_create(client, &xdg_surface_interface,
+                                                         wl_resource_get_version(resource), id);
+    if (!xdg_surface) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(xdg_surface, &xdg_surface_impl, surface, xdg_surface_destroyed);
+    surface->xdg_surface = xdg_surface;
+}
+
+static void wm_base_pong(struct wl_client* client, struct wl_resource* resource, uint32_t serial) {
+    Compositor* c = static_cast<Compositor*>(wl_resource_get_user_data(resource));
+    if (serial != c->ping_serial || !c->ping_sent_ns) return;
+    c->pong_ns = now_ns() - c->ping_sent_ns;
+    c->pong_max_ns = std::max(c->pong_max_ns, c->pong_ns);
+    c->ping_sent_ns = 0;
+}
+
+static const struct xdg_wm_base_interface wm_base_impl = {
+    .destroy = destroy_resource,
+    .create_positioner = wm_base_create_positioner,
+    .get_xdg_surface = wm_base_get_xdg_surface,
+    .pong = wm_base_pong
+};
+
+static void wm_base_destroyed(struct wl_resource* resource) {
+    Compositor* c = static_cast<Compositor*>(wl_resource_get_user_data(resource));
+    remove_resource(c->wm_bases, resource);
+}
+
+static void wm_base_bind(struct wl_client* client, void* data, uint32_t version, uint32_t id) {
+    Compositor* c = static_cast<Compositor*>(data);
+    struct wl_resource* resource = wl_resource_create(client, &xdg_wm_base_interface,
+                                                      std::min(version, static_cast<uint32_t>(XDG_WM_BASE_VERSION)), id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &wm_base_impl, c, wm_base_destroyed);
+    c->wm_bases.push_back(resource);
+}
+
+// ---- wp_viewporter (accepted, not applied) ----
+
+static void viewport_set_source(struct wl_client* client, struct wl_resource* resource, wl_fixed_t x, wl_fixed_t y,
+                                wl_fixed_t width, wl_fixed_t height) {
+}
+
+static void viewport_set_destination(struct wl_client* client, struct wl_resource* resource,
+                                     int32_t width, int32_t height) {
+}
+
+static const struct wp_viewport_interface viewport_impl = {
+    .destroy = destroy_resource,
+    .set_source = viewport_set_source,
+    .set_destination = viewport_set_destination
+};
+
+static void viewporter_get_viewport(struct wl_client* client, struct wl_resource* resource, uint32_t id,
+                                    struct wl_resource* surface) {
+    struct wl_resource* viewport = wl_resource_create(client, &wp_viewport_interface, 1, id);
+    if (!viewport) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(viewport, &viewport_impl, nullptr, nullptr);
+}
+
+static const struct wp_viewporter_interface viewporter_impl = {
+    .destroy = destroy_resource,
+    .get_viewport = viewporter_get_viewport
+};
+
+static void viewporter_bind(struct wl_client* client, void* data, uint32_t version, uint32_t id) {
+    struct wl_resource* resource = wl_resource_create(client, &wp_viewporter_interface, 1, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &viewporter_impl, data, nullptr);
+}
+
+// ---- wp_presentation ----
+
+static void presentation_feedback(struct wl_client* client, struct wl_resource* resource,
+                                  struct wl_resource* surface_resource, uint32_t id) {
+    Surface* surface = static_cast<Surface*>(wl_resource_get_user_data(surface_resource));
+    struct wl_resource* feedback = wl_resource_create(client, &wp_presentation_feedback_interface, 1, id);
+    if (!feedback) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(feedback, nullptr, surface, feedback_destroyed);
+    surface->pending_feedbacks.push_back(feedback);
+}
+
+static const struct wp_presentation_interface presentation_impl = {
+    .destroy = destroy_resource,
+    .feedback = presentation_feedback
+};
+
+static void presentation_bind(struct wl_client* client, void* data, uint32_t version, uint32_t id) {
+    struct wl_resource* resource = wl_resource_create(client, &wp_presentation_interface, 1, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &presentation_impl, data, nullptr);
+    wp_presentation_send_clock_id(resource, static_cast<uint32_t>(CLOCK_MONOTONIC));
+}
+
+// ---- Frames ----
+
+static void surface_drawn(Surface& surface) {
+    Compositor* c = surface.compositor;
+    Output& out = *c->outputs[surface.output];
+    if (!surface.entered) {
+        struct wl_resource* output = client_output(out, wl_resource_get_client(surface.resource));
+        if (output) wl_surface_send_enter(surface.resource, output);
+        surface.entered = true;
+    }
+
+    if (surface.drawn || !surface.xdg_toplevel) return;
+    surface.drawn = true;
+    if (c->startup_ns) return;
+    for (Surface* other : c->surfaces) {
+        if (other->xdg_toplevel && !other->drawn) return;
+    }
+    c->startup_ns = now_ns() - c->first_client_ns;
+    std::cout << "⏱️  Startup: every window drawn " << c->startup_ns / 1000000.0 << " ms after the client connected\n";
+}
+
+// Vblank of one output: everything committed since the previous one is
+// on screen now
+static void present(Output& out, uint64_t vblank_ns) {
+    Compositor* c = out.compositor;
+    uint32_t time_ms = static_cast<uint32_t>(vblank_ns / 1000000);
+    for (Surface* surface : c->surfaces) {
+        if (surface->output != out.index) continue;
+
+        std::vector<struct wl_resource*> done;
+        detach_all(surface->frames, done);
+        for (struct wl_resource* callback : done) {
+            wl_callback_send_done(callback, time_ms);
+            wl_resource_destroy(callback);
+        }
+
+        std::vector<struct wl_resource*> presented;
+        detach_all(surface->feedbacks, presented);
+        uint32_t flags = WP_PRESENTATION_FEEDBACK_KIND_VSYNC | WP_PRESENTATION_FEEDBACK_KIND_HW_CLOCK |
+                         WP_PRESENTATION_FEEDBACK_KIND_HW_COMPLETION;
+        if (surface->current && surface->current->width == out.mode.width && surface->current->height == out.mode.height) {
+            flags |= WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY;   // Would be scanned out as is
+        }
+        uint64_t seconds = vblank_ns / 1000000000ull;
+        for (struct wl_resource* feedback : presented) {
+            struct wl_resource* output = client_output(out, wl_resource_get_client(feedback));
+            if (output) wp_presentation_feedback_send_sync_output(feedback, output);
+            wp_presentation_feedback_send_presented(feedback, static_cast<uint32_t>(seconds >> 32), static_cast<uint32_t>(seconds),
+                                                    static_cast<uint32_t>(vblank_ns % 1000000000ull),
+                                                    static_cast<uint32_t>(out.period_ns), static_cast<uint32_t>(out.msc >> 32),
+                                                    static_cast<uint32_t>(out.msc), flags);
+            wl_resource_destroy(feedback);
+        }
+    }
+}
+
+static int output_tick(void* data) {
+    Output* out = static_cast<Output*>(data);
+    uint64_t now = now_ns();
+    uint64_t missed = now > out->next_ns ? (now - out->next_ns) / out->period_ns : 0;
+    uint64_t vblank = out->next_ns + missed * out->period_ns;
+    out->missed += missed;
+    out->msc += missed + 1;
+    out->next_ns = vblank + out->period_ns;
+    present(*out, vblank);
+
+    uint64_t delay_ns = out->next_ns - std::min(out->next_ns, now_ns());
+    wl_event_source_timer_update(out->timer, std::max(1, static_cast<int>((delay_ns + 999999) / 1000000)));
+    return 0;
+}
+
+// ---- Reports ----
+
+static int report_tick(void* data) {
+    Compositor* c = static_cast<Compositor*>(data);
+    Counters delta = c->total;
+    delta.requests -= c->reported.requests;
+    delta.events -= c->reported.events;
+    delta.fds -= c->reported.fds;
+    delta.roundtrips -= c->reported.roundtrips;
+    delta.frames -= c->reported.frames;
+    delta.configures -= c->reported.configures;
+    delta.acks -= c->reported.acks;
+    delta.mapped -= c->reported.mapped;
+    c->reported = c->total;
+
+    long rss = c->client_pid ? read_rss_kb(c->client_pid) : -1;
+    if (rss > 0) c->rss_peak_kb = std::max(c->rss_peak_kb, rss);
+
+    if (c->first_client_ns) {
+        double frames = static_cast<double>(std::max<uint64_t>(delta.frames, 1));
+        std::cout << std::fixed << std::setprecision(1) << "📊 " << delta.frames << " frames | per frame "
+                  << delta.requests / frames << " requests, " << delta.events / frames << " events, "
+                  << delta.fds / frames << " fds, " << delta.mapped / frames / 1024 << " KiB mapped | "
+                  << delta.roundtrips << " roundtrips, " << delta.configures << " configures (" << delta.acks
+                  << " acked) | " << c->pools << " pools, " << c->buffers << " buffers";
+        if (rss > 0) std::cout << " | client RSS " << rss / 1024.0 << " MiB";
+        if (c->pong_ns) std::cout << " | pong " << c->pong_ns / 1000000.0 << " ms";
+        std::cout << "\n" << std::defaultfloat;
+    }
+
+    // Next pong latency: an unanswered ping is simply replaced
+    for (struct wl_resource* wm_base : c->wm_bases) {
+        c->ping_serial = wl_display_next_serial(c->display);
+        c->ping_sent_ns = now_ns();
+        xdg_wm_base_send_ping(wm_base, c->ping_serial);
+    }
+
+    wl_event_source_timer_update(c->report_timer, REPORT_INTERVAL_MS);
+    return 0;
+}
+
+static int storm_tick(void* data) {
+    Compositor* c = static_cast<Compositor*>(data);
+    if (c->options.resize_storm) c->storm_small = !c->storm_small;
+    for (Surface* surface : c->surfaces) {
+        if (surface->xdg_toplevel && surface->configured) send_configure(*surface);
+    }
+    wl_event_source_timer_update(c->storm_timer, std::max(1, 1000 / c->options.configure_storm_hz));
+    return 0;
+}
+
+// ---- Hotplug ----
+
+// The last output goes away and comes back as a new global. Its wl_output
+// resources stay with the clients that bound them but no longer stand for
+// it; surfaces on it get no frames until the client moves or closes them.
+static int hotplug_tick(void* data) {
+    Compositor* c = static_cast<Compositor*>(data);
+    Output& out = *c->outputs.back();
+    out.connected = !out.connected;
+    if (out.connected) {
+        wl_global_destroy(out.global);
+        out.global = wl_global_create(c->display, &wl_output_interface, 4, &out, output_bind);
+        out.next_ns = now_ns() + out.period_ns;
+        wl_event_source_timer_update(out.timer, std::max(1, static_cast<int>(out.period_ns / 1000000)));
+        c->hotplugs++;
+    } else {
+        for (struct wl_resource* resource : out.resources) wl_resource_set_user_data(resource, nullptr);
+        out.resources.clear();
+        wl_global_remove(out.global);   // Destroyed when it comes back, once clients saw the removal
+        wl_event_source_timer_update(out.timer, 0);
+    }
+    std::cout << "🔌 Output " << out.index + 1 << (out.connected ? " plugged back in\n" : " unplugged\n");
+
+    wl_event_source_timer_update(c->hotplug_timer, c->options.hotplug_ms);
+    return 0;
+}
+
+static void print_summary(Compositor& c) {
+    std::cout << "\n=== MOCK COMPOSITOR ===\n" << std::fixed << std::setprecision(1);
+    if (c.startup_ns) std::cout << "startup    " << c.startup_ns / 1000000.0 << " ms to every window drawn\n";
+    double frames = static_cast<double>(std::max<uint64_t>(c.total.frames, 1));
+    std::cout << "frames     " << c.total.frames << ", per frame " << c.total.requests / frames << " requests, "
+              << c.total.events / frames << " events, " << c.total.fds / frames << " fds, "
+              << c.total.mapped / frames / 1024 << " KiB mapped\n";
+    std::cout << "protocol   " << c.total.requests << " requests, " << c.total.events << " events, "
+              << c.total.fds << " fds, " << c.total.roundtrips << " roundtrips\n";
+    std::cout << "configure  " << c.total.configures << " sent, " << c.total.acks << " acked\n";
+    if (c.hotplugs) std::cout << "hotplug    " << c.hotplugs << " times unplugged and plugged back\n";
+    std::cout << "memory     " << (c.total.mapped >> 20) << " MiB mapped in all, at most "
+              << (c.peak_mapped_bytes >> 20) << " MiB at once";
+    if (c.rss_first_kb > 0) {
+        std::cout << ", client RSS " << c.rss_first_kb / 1024 << " -> " << c.rss_peak_kb / 1024 << " MiB peak";
+    }
+    std::cout << "\n";
+    if (c.pong_max_ns) std::cout << "pong       max " << c.pong_max_ns / 1000000.0 << " ms\n";
+    for (auto& out : c.outputs) {
+        std::cout << "output " << out->index + 1 << "   " << out->msc << " vblanks, " << out->missed << " missed\n";
+    }
+    std::cout << "=======================\n" << std::defaultfloat;
+}
+
+// ---- Process ----
+
+static void client_created(struct wl_listener* listener, void* data) {
+    Compositor* c = wl_container_of(listener, c, client_created);
+    if (c->first_client_ns) return;
+    c->first_client_ns = now_ns();
+    pid_t pid;
+    uid_t uid;
+    gid_t gid;
+    wl_client_get_credentials(static_cast<struct wl_client*>(data), &pid, &uid, &gid);
+    c->client_pid = pid;
+    c->rss_first_kb = read_rss_kb(pid);
+    c->rss_peak_kb = c->rss_first_kb;
+}
+
+static int on_signal(int signal_number, void* data) {
+    Compositor* c = static_cast<Compositor*>(data);
+    if (signal_number == SIGCHLD) {
+        int status;
+        if (c->child <= 0 || waitpid(c->child, &status, WNOHANG) != c->child) return 0;
+        std::cout << "👋 Client exited with status " << (WIFEXITED(status) ? WEXITSTATUS(status) : -1) << "\n";
+        c->child = -1;
+    }
+    c->running = false;
+    return 0;
+}
+
+static int on_duration(void* data) {
+    static_cast<Compositor*>(data)->running = false;
+    return 0;
+}
+
+static pid_t spawn(char** command, const char* socket) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        // wl_event_loop_add_signal() blocked these for its signalfd
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        setenv("WAYLAND_DISPLAY", socket, 1);
+        execvp(command[0], command);
+        perror(command[0]);
+        _exit(127);
+    }
+    return pid;
+}
+
+static bool parse_mode(const char* text, Mode& mode) {
+    double hz = 60.0;
+    int n = sscanf(text, "%dx%d@%lf", &mode.width, &mode.height, &hz);
+    if (n < 2 || mode.width <= 0 || mode.height <= 0 || hz <= 0) return false;
+    mode.refresh_mhz = static_cast<int>(hz * 1000 + 0.5);
+    return true;
+}
+
+static void usage(const char* name) {
+    std::cerr << "Usage: " << name << " [--outputs N] [--mode WxH[@HZ]]... [--scale N] [--no-viewporter]\n"
+                 "       [--no-presentation] [--latency-ms N] [--configure-storm HZ] [--resize-storm HZ]\n"
+                 "       [--hotplug MS] [--duration S] [-- COMMAND ARGS...]\n"
+                 "  --mode is given per output in order; the last one is used for the rest\n"
+                 "  --hotplug unplugs the last output every other MS milliseconds and plugs it back in between\n";
+}
+
+static bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (std::strcmp(arg, "--") == 0) {
+            if (has_value) options.command = argv + i + 1;
+            break;
+        } else if (std::strcmp(arg, "--outputs") == 0 && has_value) {
+            options.outputs = std::max(1, atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--mode") == 0 && has_value) {
+            Mode mode;
+            if (!parse_mode(argv[++i], mode)) return false;
+            options.modes.push_back(mode);
+        } else if (std::strcmp(arg, "--scale") == 0 && has_value) {
+            options.scale = std::max(1, atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--no-viewporter") == 0) {
+            options.viewporter = false;
+        } else if (std::strcmp(arg, "--no-presentation") == 0) {
+            options.presentation = false;
+        } else if (std::strcmp(arg, "--latency-ms") == 0 && has_value) {
+            options.latency_ms = std::max(0, atoi(argv[++i]));
+        } else if ((std::strcmp(arg, "--configure-storm") == 0 || std::strcmp(arg, "--resize-storm") == 0) && has_value) {
+            options.resize_storm = std::strcmp(arg, "--resize-storm") == 0;
+            options.configure_storm_hz = std::max(0, atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--hotplug") == 0 && has_value) {
+            options.hotplug_ms = std::max(0, atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--duration") == 0 && has_value) {
+            options.duration_s = std::max(0, atoi(argv[++i]));
+        } else {
+            return false;
+        }
+    }
+    if (options.modes.empty()) options.modes.push_back(Mode());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Compositor c;
+    if (!parse_options(argc, argv, c.options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    c.display = wl_display_create();
+    if (!c.display) {
+        std::cerr << "❌ wl_display_create() failed\n";
+        return 1;
+    }
+    c.loop = wl_display_get_event_loop(c.display);
+    c.socket = wl_display_add_socket_auto(c.display);
+    if (!c.socket) {
+        std::cerr << "❌ Cannot create a Wayland socket (is XDG_RUNTIME_DIR set?)\n";
+        wl_display_destroy(c.display);
+        return 1;
+    }
+
+    wl_display_add_protocol_logger(c.display, protocol_logger, &c);
+    c.client_created.notify = client_created;
+    wl_display_add_client_created_listener(c.display, &c.client_created);
+
+    wl_global_create(c.display, &wl_compositor_interface, 4, &c, compositor_bind);
+    wl_global_create(c.display, &wl_shm_interface, 1, &c, shm_bind);
+    wl_global_create(c.display, &xdg_wm_base_interface, XDG_WM_BASE_VERSION, &c, wm_base_bind);
+    if (c.options.viewporter) wl_global_create(c.display, &wp_viewporter_interface, 1, &c, viewporter_bind);
+    if (c.options.presentation) wl_global_create(c.display, &wp_presentation_interface, 1, &c, presentation_bind);
+
+    int x = 0;
+    uint64_t start = now_ns();
+    for (int i = 0; i < c.options.outputs; ++i) {
+        auto out = std::make_unique<Output>();
+        out->compositor = &c;
+        out->index = i;
+        out->mode = c.options.modes[std::min<size_t>(i, c.options.modes.size() - 1)];
+        out->x = x;
+        x += out->mode.width / c.options.scale;
+        out->period_ns = 1000000000000ull / out->mode.refresh_mhz;
+        out->next_ns = start + out->period_ns;
+        out->global = wl_global_create(c.display, &wl_output_interface, 4, out.get(), output_bind);
+        out->timer = wl_event_loop_add_timer(c.loop, output_tick, out.get());
+        wl_event_source_timer_update(out->timer, std::max(1, static_cast<int>(out->period_ns / 1000000)));
+        std::cout << "🖥️  Output " << i + 1 << ": " << out->mode.width << "x" << out->mode.height << " @ "
+                  << out->mode.refresh_mhz / 1000.0 << " Hz, scale " << c.options.scale << "\n";
+        c.outputs.push_back(std::move(out));
+    }
+
+    c.report_timer = wl_event_loop_add_timer(c.loop, report_tick, &c);
+    wl_event_source_timer_update(c.report_timer, REPORT_INTERVAL_MS);
+    if (c.options.configure_storm_hz) {
+        c.storm_timer = wl_event_loop_add_timer(c.loop, storm_tick, &c);
+        wl_event_source_timer_update(c.storm_timer, std::max(1, 1000 / c.options.configure_storm_hz));
+        std::cout << "🌪️  " << (c.options.resize_storm ? "Resize" : "Configure") << " storm at "
+                  << c.options.configure_storm_hz << " Hz\n";
+    }
+    if (c.options.hotplug_ms) {
+        c.hotplug_timer = wl_event_loop_add_timer(c.loop, hotplug_tick, &c);
+        wl_event_source_timer_update(c.hotplug_timer, c.options.hotplug_ms);
+        std::cout << "🔌 Output " << c.options.outputs << " unplugged and plugged back every "
+                  << c.options.hotplug_ms << " ms\n";
+    }
+    if (c.options.duration_s) {
+        c.duration_timer = wl_event_loop_add_timer(c.loop, on_duration, &c);
+        wl_event_source_timer_update(c.duration_timer, c.options.duration_s * 1000);
+    }
+    if (c.options.latency_ms) {
+        std::cout << "🐢 Stalling " << c.options.latency_ms << " ms after every dispatch\n";
+    }
+
+    struct wl_event_source* signals[] = {
+        wl_event_loop_add_signal(c.loop, SIGINT, on_signal, &c),
+        wl_event_loop_add_signal(c.loop, SIGTERM, on_signal, &c),
+        wl_event_loop_add_signal(c.loop, SIGCHLD, on_signal, &c),
+    };
+
+    std::cout << "▶️ Mock compositor on WAYLAND_DISPLAY=" << c.socket << "\n";
+    if (c.options.command) {
+        c.child = spawn(c.options.command, c.socket);
+        if (c.child == -1) c.running = false;
+    }
+
+    while (c.running) {
+        wl_display_flush_clients(c.display);
+        if (wl_event_loop_dispatch(c.loop, -1) == -1 && errno != EINTR) {
+            perror("wl_event_loop_dispatch");
+            break;
+        }
+        if (c.options.latency_ms) usleep(c.options.latency_ms * 1000);
+    }
+
+    if (c.child > 0) {
+        kill(c.child, SIGTERM);
+        waitpid(c.child, nullptr, 0);
+    }
+    print_summary(c);
+
+    for (struct wl_event_source* source : signals) {
+        if (source) wl_event_source_remove(source);
+    }
+    wl_display_destroy_clients(c.display);
+    wl_display_destroy(c.display);
+    return 0;
+}
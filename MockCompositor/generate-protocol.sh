@@ -0,0 +1,29 @@
+#!/bin/sh
+# Generates the server headers MockCompositor includes. They must come from
+# the same protocol XML as the client glue in the parent directory, which
+# is checked for by comparing the since-versions of both sides.
+#
+# Needs wayland-scanner and wayland-protocols; WAYLAND_PROTOCOLS_DIR
+# overrides the pkg-config lookup of the XML files.
+set -e
+cd "$(dirname "$0")"
+
+protocols=${WAYLAND_PROTOCOLS_DIR:-$(pkg-config --variable=pkgdatadir wayland-protocols)}
+client=$(mktemp)
+server=$(mktemp)
+trap 'rm -f "$client" "$server"' EXIT
+
+for xml in stable/xdg-shell/xdg-shell.xml \
+           stable/viewporter/viewporter.xml \
+           stable/presentation-time/presentation-time.xml; do
+    name=$(basename "$xml" .xml)
+    wayland-scanner server-header "$protocols/$xml" "$name-server-protocol.h"
+
+    grep '#define .*_SINCE_VERSION' "../$name-client-protocol.h" > "$client"
+    grep '#define .*_SINCE_VERSION' "$name-server-protocol.h" > "$server"
+    if ! cmp -s "$client" "$server"; then
+        echo "$protocols/$xml is not the version ../$name-client-protocol.h was generated from" >&2
+        rm -f "$name-server-protocol.h"
+        exit 1
+    fi
+done
@@ -0,0 +1,229 @@
+#include "PerfCounters.h"
+#include "Log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define HW_CACHE_MISS(cache, op) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_##op << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+struct PerfEvent {
+    PerfCounter counter;
+    uint32_t type;
+    uint64_t config;
+};
+
+// The first one leads the group. The generic cache-miss event counts
+// last-level misses including stores (RFOs), which is what a fill does;
+// dTLB misses are split by the kernel into loads and stores.
+static const PerfEvent perf_events[] = {
+    { PERF_CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_DTLB_MISSES, PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB, READ) },
+    { PERF_DTLB_MISSES, PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB, WRITE) },
+};
+
+#define PERF_EVENTS (sizeof(perf_events) / sizeof(perf_events[0]))
+
+static const char* const counter_names[PERF_COUNTERS] = {
+    "cycles", "instructions", "LLC misses", "dTLB misses"
+};
+
+std::atomic<bool> perf_enabled_flag{false};
+static std::atomic<unsigned> usable{0};         // Bit per event perf_start() could schedule
+
+// The counters of one thread, read together in one read()
+struct PerfGroup {
+    bool opened = false;
+    int members = 0;                            // Leader first
+    int fds[PERF_EVENTS];
+    int events[PERF_EVENTS];                    // Index into perf_events of each member
+
+    ~PerfGroup() { close_all(); }
+
+    void close_all() {
+        for (int i = 0; i < members; ++i) close(fds[i]);
+        members = 0;
+    }
+
+    // Returns false if the leader cannot be opened; other events are
+    // left out when they fail
+    bool open(unsigned mask) {
+        for (size_t i = 0; i < PERF_EVENTS; ++i) {
+            if (!(mask & (1u << i))) continue;
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = perf_events[i].type;
+            attr.config = perf_events[i].config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1,
+                                              members ? fds[0] : -1, PERF_FLAG_FD_CLOEXEC));
+            if (fd == -1) {
+                if (!members) return false;
+                continue;
+            }
+            fds[members] = fd;
+            events[members++] = static_cast<int>(i);
+        }
+        return true;
+    }
+
+    // Counts summed per counter, then time enabled and time running
+    bool read_counts(uint64_t out[PERF_COUNTERS + 2]) const {
+        uint64_t buffer[3 + PERF_EVENTS];       // nr, enabled, running, values
+        ssize_t n = read(fds[0], buffer, sizeof(buffer));
+        if (n < static_cast<ssize_t>((3 + members) * sizeof(uint64_t))) return false;
+        memset(out, 0, (PERF_COUNTERS + 2) * sizeof(uint64_t));
+        for (int i = 0; i < members; ++i) out[perf_events[events[i]].counter] += buffer[3 + i];
+        out[PERF_COUNTERS] = buffer[1];
+        out[PERF_COUNTERS + 1] = buffer[2];
+        return true;
+    }
+};
+
+static thread_local PerfGroup group;
+
+static bool counter_available(int counter) {
+    unsigned mask = usable.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < PERF_EVENTS; ++i) {
+        if ((mask & (1u << i)) && perf_events[i].counter == counter) return true;
+    }
+    return false;
+}
+
+static std::string paranoid_level() {
+    std::ifstream file("/proc/sys/kernel/perf_event_paranoid");
+    std::string level;
+    file >> level;
+    return level.empty() ? "unknown" : level;
+}
+
+bool perf_start() {
+    PerfGroup probe;
+    if (!probe.open((1u << PERF_EVENTS) - 1)) {
+        int error = errno;
+        LOG_WARN << "⚠️  Hardware counters unavailable: perf_event_open: " << strerror(error)
+                 << (error == EACCES || error == EPERM
+                         ? " (kernel.perf_event_paranoid = " + paranoid_level() + ")"
+                         : std::string(error == ENOENT || error == EOPNOTSUPP ? " (no PMU, virtual machine?)" : ""));
+        return false;
+    }
+
+    // A group that needs more counters than the core has is never
+    // scheduled at all: drop members from the end until it runs
+    for (;;) {
+        volatile uint64_t sink = 0;
+        for (int i = 0; i < 100000; ++i) sink += i;
+        uint64_t counts[PERF_COUNTERS + 2];
+        if (probe.read_counts(counts) && counts[PERF_COUNTERS + 1] > 0) break;
+
+        if (probe.members == 1) {
+            LOG_WARN << "⚠️  Hardware counters unavailable: the cycle counter is never scheduled";
+            return false;
+        }
+        // The events of one counter (dTLB loads and stores) go together:
+        // one of them alone would be reported as the whole counter
+        int keep = probe.members - 1;
+        PerfCounter dropped = perf_events[probe.events[keep]].counter;
+        while (keep > 1 && perf_events[probe.events[keep - 1]].counter == dropped) keep--;
+        unsigned mask = 0;
+        for (int i = 0; i < keep; ++i) mask |= 1u << probe.events[i];
+        probe.close_all();
+        if (!probe.open(mask)) {
+            LOG_WARN << "⚠️  Hardware counters unavailable: perf_event_open: " << strerror(errno);
+            return false;
+        }
+    }
+
+    // Events the kernel refused are missing from the probe's group. A
+    // counter with one of its events refused is left out altogether.
+    unsigned opened = 0;
+    for (int i = 0; i < probe.members; ++i) opened |= 1u << probe.events[i];
+    for (size_t i = 0; i < PERF_EVENTS; ++i) {
+        if (opened & (1u << i)) continue;
+        for (size_t j = 0; j < PERF_EVENTS; ++j) {
+            if (perf_events[j].counter == perf_events[i].counter) opened &= ~(1u << j);
+        }
+    }
+    usable.store(opened, std::memory_order_relaxed);
+
+    LogLine line(LogLevel::Info);
+    line << "📊 Hardware counters around the render kernels:";
+    for (int counter = 0; counter < PERF_COUNTERS; ++counter) {
+        line << ' ' << counter_names[counter] << (counter_available(counter) ? "" : " (n/a)")
+             << (counter + 1 < PERF_COUNTERS ? "," : "");
+    }
+    perf_enabled_flag.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+// The first kernel a thread runs opens its group; a thread whose group
+// cannot be opened (e.g. out of fds) runs its kernels uncounted
+void PerfScope::begin(PerfStats& stats) {
+    if (!group.opened) {
+        group.opened = true;
+        if (!group.open(usable.load(std::memory_order_relaxed))) group.close_all();
+    }
+    if (!group.members || !group.read_counts(start_)) return;
+    stats_ = &stats;
+}
+
+// Counts are scaled by the share of the scope the group was scheduled,
+// which is all of it unless other perf users multiplex the counters
+void PerfScope::end() {
+    uint64_t now[PERF_COUNTERS + 2];
+    if (!group.read_counts(now)) return;
+    uint64_t enabled = now[PERF_COUNTERS] - start_[PERF_COUNTERS];
+    uint64_t running = now[PERF_COUNTERS + 1] - start_[PERF_COUNTERS + 1];
+    if (!running) return;
+
+    double scale = static_cast<double>(enabled) / running;
+    for (int counter = 0; counter < PERF_COUNTERS; ++counter) {
+        uint64_t delta = static_cast<uint64_t>((now[counter] - start_[counter]) * scale + 0.5);
+        stats_->counts[counter].fetch_add(delta, std::memory_order_relaxed);
+    }
+    stats_->pixels.fetch_add(pixels_, std::memory_order_relaxed);
+}
+
+void PerfStats::dump(std::ostream& out, const char* label, uint64_t units, const char* unit) const {
+    uint64_t total_pixels = pixels.load(std::memory_order_relaxed);
+    if (!total_pixels) return;
+
+    uint64_t totals[PERF_COUNTERS];
+    for (int counter = 0; counter < PERF_COUNTERS; ++counter) {
+        totals[counter] = counts[counter].load(std::memory_order_relaxed);
+    }
+
+    auto line = [&](const char* per, double divisor) {
+        out << "    " << label << " per " << per << ":";
+        for (int counter = 0; counter < PERF_COUNTERS; ++counter) {
+            out << (counter ? ", " : " ");
+            if (counter_available(counter)) {
+                out << totals[counter] / divisor;
+            } else {
+                out << "n/a";
+            }
+            out << ' ' << counter_names[counter];
+        }
+        out << "\n";
+    };
+
+    out << std::fixed << std::setprecision(0);
+    line(unit, static_cast<double>(units ? units : 1));
+    line("megapixel", total_pixels / 1e6);
+    if (totals[PERF_CYCLES] && counter_available(PERF_INSTRUCTIONS)) {
+        out << "    " << label << " IPC " << std::setprecision(2)
+            << static_cast<double>(totals[PERF_INSTRUCTIONS]) / totals[PERF_CYCLES] << "\n";
+    }
+    out << std::defaultfloat;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Hardware counters around the render kernels (--perf-counters): cycles,
+// instructions, last-level cache misses and dTLB misses, read with
+// perf_event_open() on whichever thread runs the kernel. Instructions per
+// cycle and misses per megapixel tell a memory-bound fill from a
+// compute-bound one, so a SIMD, huge-page or threading change to the
+// kernels shows up as a number on the hardware it runs on.
+//
+// Every thread opens its own counter group the first time it runs a
+// kernel. Only user space is counted: the page faults of a buffer's first
+// fill are not. Counters the CPU, the hypervisor or
+// kernel.perf_event_paranoid do not allow are reported as n/a; with no
+// cycle counter at all the mode stays off. Off, a scope costs one relaxed
+// load.
+
+enum PerfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,            // Loads and stores
+    PERF_COUNTERS
+};
+
+// Counts of one kernel of one window, summed over every thread that ran it
+struct PerfStats {
+    std::atomic<uint64_t> counts[PERF_COUNTERS] = {};
+    std::atomic<uint64_t> pixels{0};
+
+    // Per unit (e.g. frames drawn) and per megapixel
+    void dump(std::ostream& out, const char* label, uint64_t units, const char* unit) const;
+};
+
+extern std::atomic<bool> perf_enabled_flag;
+
+inline bool perf_enabled() {
+    return perf_enabled_flag.load(std::memory_order_relaxed);
+}
+
+// Probe the counters on the calling thread and enable them. Returns false,
+// with a warning saying why, if not even cycles can be counted.
+bool perf_start();
+
+// Charges the kernel run on this thread while the scope lives to stats
+class PerfScope {
+public:
+    PerfScope(PerfStats& stats, uint64_t pixels) : stats_(nullptr), pixels_(pixels) {
+        if (perf_enabled()) begin(stats);
+    }
+
+    ~PerfScope() {
+        if (stats_) end();
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+    void begin(PerfStats& stats);
+    void end();
+
+    PerfStats* stats_;
+    uint64_t pixels_;
+    uint64_t start_[PERF_COUNTERS + 2];      // Counters, then time enabled and running
+};
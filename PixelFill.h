@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Solid-color fill kernels, selected once at startup from the CPU features
+// (SSE2 / AVX2 / AVX-512 on x86-64, NEON on ARM, scalar otherwise).
+// Spans larger than the last-level cache are written with non-temporal
+// stores, since the compositor reads the buffer and we never touch it again.
+
+enum class FillIsa { Scalar, SSE2, AVX2, AVX512, NEON };
+
+typedef void (*pixel_fill_fn)(uint32_t* dst, size_t count, uint32_t value);
+
+struct PixelFillKernel {
+    FillIsa isa;
+    const char* name;
+    pixel_fill_fn fill;     // Regular stores
+    pixel_fill_fn stream;   // Non-temporal stores (same as fill where unavailable)
+};
+
+// Detect CPU features and cache size, select the best kernel
+void pixel_fill_init();
+
+// Fill count pixels starting at dst with value
+void pixel_fill(uint32_t* dst, size_t count, uint32_t value);
+
+// Same, for one band of a larger buffer: stream tells whether the whole
+// buffer is big enough for non-temporal stores (see pixel_fill_streams)
+void pixel_fill(uint32_t* dst, size_t count, uint32_t value, bool stream);
+bool pixel_fill_streams(size_t bytes);
+
+const PixelFillKernel& pixel_fill_kernel();
+size_t pixel_fill_llc_size();
+
+// Time every kernel supported by this CPU against the original scalar loop
+int pixel_fill_benchmark(int width, int height, int iterations);
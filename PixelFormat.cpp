@@ -0,0 +1,69 @@
+#include "PixelFormat.h"
+
+#include <algorithm>
+#include <strings.h>
+
+static const PixelFormatInfo formats[] = {
+    { PixelFormat::XRGB8888, "xrgb8888", WL_SHM_FORMAT_XRGB8888, 4, 8, 8, 8 },
+    { PixelFormat::RGB565, "rgb565", WL_SHM_FORMAT_RGB565, 2, 5, 6, 5 },
+    { PixelFormat::XRGB2101010, "xrgb2101010", WL_SHM_FORMAT_XRGB2101010, 4, 10, 10, 10 },
+};
+
+const PixelFormatInfo& pixel_format_info(PixelFormat format) {
+    return formats[static_cast<int>(format)];
+}
+
+bool pixel_format_from_name(const char* name, PixelFormat& format) {
+    for (const PixelFormatInfo& info : formats) {
+        if (strcasecmp(name, info.name) == 0) {
+            format = info.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t pixel_format_bit(uint32_t shm_format) {
+    for (const PixelFormatInfo& info : formats) {
+        if (info.shm_format == shm_format) return pixel_format_bit(info.format);
+    }
+    return 0;
+}
+
+uint32_t pixel_format_bit(PixelFormat format) {
+    return 1u << static_cast<int>(format);
+}
+
+// Fewest bits that reproduce an 8-bit channel value once the compositor
+// widens it back by bit replication
+static int channel_bits(uint32_t value) {
+    for (int bits = 1; bits < 8; ++bits) {
+        uint32_t narrow = value >> (8 - bits);
+        uint32_t wide = 0;
+        for (int shift = 8 - bits; shift > -bits; shift -= bits) {
+            wide |= shift >= 0 ? narrow << shift : narrow >> -shift;
+        }
+        if ((wide & 0xFF) == value) return bits;
+    }
+    return 8;
+}
+
+PixelFormat pixel_format_choose(uint32_t supported, const uint32_t* colors, size_t count) {
+    int red = 0, green = 0, blue = 0;
+    for (size_t i = 0; i < count; ++i) {
+        red = std::max(red, channel_bits((colors[i] >> 16) & 0xFF));
+        green = std::max(green, channel_bits((colors[i] >> 8) & 0xFF));
+        blue = std::max(blue, channel_bits(colors[i] & 0xFF));
+    }
+
+    const PixelFormatInfo* best = &pixel_format_info(PixelFormat::XRGB8888);
+    for (const PixelFormatInfo& info : formats) {
+        if (!(supported & pixel_format_bit(info.format))) continue;
+        if (info.red_bits < red || info.green_bits < green || info.blue_bits < blue) continue;
+
+        int bits = info.red_bits + info.green_bits + info.blue_bits;
+        int best_bits = best->red_bits + best->green_bits + best->blue_bits;
+        if (info.bytes < best->bytes || (info.bytes == best->bytes && bits < best_bits)) best = &info;
+    }
+    return best->format;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "PixelFill.h"
+
+extern "C" {
+#include <wayland-client.h>
+}
+
+// Buffer formats the renderer can draw. Each one has a traits type below,
+// so the draw kernels are instantiated per format with no per-pixel
+// branching, and a runtime descriptor used to negotiate with wl_shm.
+// Colors are always given as XRGB8888 values and converted by pack().
+
+enum class PixelFormat { XRGB8888, RGB565, XRGB2101010 };
+
+struct PixelFormatInfo {
+    PixelFormat format;
+    const char* name;
+    uint32_t shm_format;
+    int bytes;                  // Per pixel
+    int red_bits, green_bits, blue_bits;
+};
+
+struct FormatXRGB8888 {
+    typedef uint32_t Pixel;
+    static constexpr PixelFormat format = PixelFormat::XRGB8888;
+
+    static Pixel pack(uint32_t rgb) { return rgb & 0x00FFFFFF; }
+};
+
+struct FormatRGB565 {
+    typedef uint16_t Pixel;
+    static constexpr PixelFormat format = PixelFormat::RGB565;
+
+    static Pixel pack(uint32_t rgb) {
+        return static_cast<Pixel>(((rgb >> 8) & 0xF800) | ((rgb >> 5) & 0x07E0) | ((rgb >> 3) & 0x001F));
+    }
+};
+
+struct FormatXRGB2101010 {
+    typedef uint32_t Pixel;
+    static constexpr PixelFormat format = PixelFormat::XRGB2101010;
+
+    // 8 to 10 bits by replicating the top bits, so 0xFF maps to 0x3FF
+    static uint32_t widen(uint32_t c) { return (c << 2) | (c >> 6); }
+    static Pixel pack(uint32_t rgb) {
+        return (widen((rgb >> 16) & 0xFF) << 20) | (widen((rgb >> 8) & 0xFF) << 10) | widen(rgb & 0xFF);
+    }
+};
+
+// Fill count pixels starting at dst with rgb. 16-bit pixels are written in
+// pairs through the 32-bit kernels, so every format gets the SIMD and
+// non-temporal paths of pixel_fill().
+template <typename Format>
+inline void pixel_fill_span(typename Format::Pixel* dst, size_t count, uint32_t rgb, bool stream) {
+    typename Format::Pixel pixel = Format::pack(rgb);
+    if constexpr (sizeof(pixel) == sizeof(uint32_t)) {
+        pixel_fill(reinterpret_cast<uint32_t*>(dst), count, pixel, stream);
+    } else {
+        static_assert(sizeof(pixel) == sizeof(uint16_t), "unsupported pixel size");
+        if (count && (reinterpret_cast<uintptr_t>(dst) & 2)) {
+            *dst++ = pixel;
+            --count;
+        }
+        pixel_fill(reinterpret_cast<uint32_t*>(dst), count / 2, pixel * 0x00010001u, stream);
+        if (count & 1) dst[count - 1] = pixel;
+    }
+}
+
+const PixelFormatInfo& pixel_format_info(PixelFormat format);
+
+// Format for a --format name, false if there is none
+bool pixel_format_from_name(const char* name, PixelFormat& format);
+
+// Bit of a wl_shm format in a supported-format mask, 0 if we cannot draw it
+uint32_t pixel_format_bit(uint32_t shm_format);
+uint32_t pixel_format_bit(PixelFormat format);
+
+// The cheapest format in supported (fewest bytes per pixel, then fewest
+// bits) that shows every one of colors exactly. XRGB8888 is mandatory in
+// wl_shm, so there always is one.
+PixelFormat pixel_format_choose(uint32_t supported, const uint32_t* colors, size_t count);
@@ -0,0 +1,64 @@
+#include "ProtocolStats.h"
+
+#include <iomanip>
+#include <time.h>
+
+void ProtocolStats::dump(std::ostream& out, const char* label, uint64_t units, const char* unit) const {
+    uint64_t sent = requests.load(std::memory_order_relaxed);
+    uint64_t received = events.load(std::memory_order_relaxed);
+    if (!sent && !received) return;
+
+    double n = static_cast<double>(units ? units : 1);
+    out << std::fixed << std::setprecision(2);
+    out << "    " << label;
+    if (unit) out << " per " << unit;
+    out << ": " << sent / n << " requests, " << received / n << " events, "
+        << fds.load(std::memory_order_relaxed) / n << " fds, " << flushes.load(std::memory_order_relaxed) / n
+        << " flushes (" << flush_bytes.load(std::memory_order_relaxed) / n << " bytes), "
+        << reads.load(std::memory_order_relaxed) / n << " reads\n";
+    if (flush_ns.count()) {
+        out << "    " << label << " flush p50 " << flush_ns.percentile(50) / 1000.0 << " us, p99 "
+            << flush_ns.percentile(99) / 1000.0 << " us, max " << flush_ns.max() / 1000.0 << " us\n";
+    }
+    out << std::defaultfloat;
+}
+
+#if PROTOCOL_STATS
+
+static thread_local ProtocolStats* current = nullptr;
+
+ProtocolScope::ProtocolScope(ProtocolStats& stats) : previous_(current) {
+    current = &stats;
+}
+
+ProtocolScope::~ProtocolScope() {
+    current = previous_;
+}
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+int protocol_flush(struct wl_display* display, ProtocolStats& stats) {
+    uint64_t start = now_ns();
+    int sent = wl_display_flush(display);
+    stats.flush_ns.record(now_ns() - start);
+    stats.flushes.fetch_add(1, std::memory_order_relaxed);
+    if (sent > 0) stats.flush_bytes.fetch_add(sent, std::memory_order_relaxed);
+    return sent;
+}
+
+int protocol_read_events(struct wl_display* display, ProtocolStats& stats) {
+    stats.reads.fetch_add(1, std::memory_order_relaxed);
+    return wl_display_read_events(display);
+}
+
+void protocol_request(int fds) {
+    if (!current) return;
+    current->requests.fetch_add(1, std::memory_order_relaxed);
+    if (fds) current->fds.fetch_add(fds, std::memory_order_relaxed);
+}
+
+#endif
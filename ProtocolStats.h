@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#include "FrameStats.h"
+
+extern "C" {
+#include <wayland-client.h>
+}
+
+// Protocol traffic of one window, or of the main loop: requests sent, fds
+// passed, events dispatched, and the wl_display_flush() / read_events()
+// syscalls with the bytes and time they took. Printed per frame (window)
+// or per loop tick, so a change that adds protocol to create_buffer()
+// shows up as a number.
+//
+// Only built with -DPROTOCOL_STATS=1; otherwise every hook below is the
+// plain libwayland call or nothing. Requests are counted where they are
+// sent, by a protocol_request() next to each call, and charged to the
+// ProtocolScope active on the calling thread. Events are counted per event
+// queue, and, without --threaded, per window by the listeners of its
+// objects through their user data.
+
+#ifndef PROTOCOL_STATS
+#define PROTOCOL_STATS 0
+#endif
+
+struct ProtocolStats {
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> fds{0};
+    std::atomic<uint64_t> events{0};
+    std::atomic<uint64_t> reads{0};     // wl_display_read_events()
+    std::atomic<uint64_t> flushes{0};
+    std::atomic<uint64_t> flush_bytes{0};
+    Histogram flush_ns;
+
+    // Totals divided by units, e.g. frames drawn or loop iterations; plain
+    // totals when unit is null
+    void dump(std::ostream& out, const char* label, uint64_t units, const char* unit) const;
+};
+
+#if PROTOCOL_STATS
+
+// Requests made on this thread while the scope lives are charged to stats
+class ProtocolScope {
+public:
+    explicit ProtocolScope(ProtocolStats& stats);
+    ~ProtocolScope();
+
+    ProtocolScope(const ProtocolScope&) = delete;
+    ProtocolScope& operator=(const ProtocolScope&) = delete;
+
+private:
+    ProtocolStats* previous_;
+};
+
+int protocol_flush(struct wl_display* display, ProtocolStats& stats);
+int protocol_read_events(struct wl_display* display, ProtocolStats& stats);
+
+// One request, passing fds file descriptors, just sent on this thread
+void protocol_request(int fds = 0);
+
+// Charge the result of a wl_display_dispatch*_pending() call
+inline int protocol_events(int dispatched, ProtocolStats& stats) {
+    if (dispatched > 0) stats.events.fetch_add(dispatched, std::memory_order_relaxed);
+    return dispatched;
+}
+
+// One event delivered to a listener; stats is null when the dispatch that
+// delivered it is already charged to the same stats
+inline void protocol_event(ProtocolStats* stats) {
+    if (stats) stats->events.fetch_add(1, std::memory_order_relaxed);
+}
+
+#else
+
+class ProtocolScope {
+public:
+    explicit ProtocolScope(ProtocolStats&) {}
+};
+
+inline int protocol_flush(struct wl_display* display, ProtocolStats&) {
+    return wl_display_flush(display);
+}
+
+inline int protocol_read_events(struct wl_display* display, ProtocolStats&) {
+    return wl_display_read_events(display);
+}
+
+inline void protocol_request(int = 0) {}
+
+inline int protocol_events(int dispatched, ProtocolStats&) {
+    return dispatched;
+}
+
+inline void protocol_event(ProtocolStats*) {}
+
+#endif
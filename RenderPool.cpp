@@ -0,0 +1,181 @@
+#include "RenderPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <sched.h>
+
+// Bands smaller than this cost more to hand out than to fill
+#define MIN_BAND_BYTES (64 * 1024)
+
+// Bands per thread, so uneven bands still balance out
+#define BANDS_PER_THREAD 4
+
+RenderPool::RenderPool(int threads) {
+    if (threads <= 0) threads = cpu_budget();
+    // The caller of run() is one of the threads
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back(&RenderPool::worker_loop, this, i);
+    }
+}
+
+RenderPool::~RenderPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void RenderPool::split_rows(std::vector<RenderTask>& tasks, void (*fn)(void*, size_t, size_t),
+                            void* ctx, size_t rows, size_t stride) const {
+    split_rows(tasks, fn, ctx, 0, rows, stride);
+}
+
+void RenderPool::split_rows(std::vector<RenderTask>& tasks, void (*fn)(void*, size_t, size_t),
+                            void* ctx, size_t first, size_t last, size_t stride) const {
+    if (last <= first || stride == 0) return;
+    size_t rows = last - first;
+
+    // Smallest row count whose byte size is a multiple of the cache line
+    size_t granule = CACHE_LINE_SIZE / std::gcd(stride, static_cast<size_t>(CACHE_LINE_SIZE));
+    size_t min_rows = (MIN_BAND_BYTES + stride - 1) / stride;
+    size_t bands = static_cast<size_t>(size()) * BANDS_PER_THREAD;
+    size_t band_rows = std::max((rows + bands - 1) / bands, min_rows);
+    band_rows = (band_rows + granule - 1) / granule * granule;
+
+    for (size_t begin = first; begin < last;) {
+        size_t end = std::min(last, (begin / band_rows + 1) * band_rows);
+        tasks.push_back({ fn, ctx, begin, end });
+        begin = end;
+    }
+}
+
+void RenderPool::run(const std::vector<RenderTask>& tasks) {
+    if (tasks.empty()) return;
+
+    if (workers.empty()) {
+        for (const auto& task : tasks) task.fn(task.ctx, task.begin, task.end);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch = &tasks;
+        next_task = 0;
+        pending = tasks.size();
+        ++generation;
+    }
+    work_cv.notify_all();
+
+    drain();
+
+    // Wait for the last task and for every worker to leave drain(), so the
+    // next batch can safely reset next_task
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return pending == 0 && active == 0; });
+    batch = nullptr;
+}
+
+void RenderPool::drain() {
+    const std::vector<RenderTask>& tasks = *batch;
+    for (;;) {
+        size_t i = next_task.fetch_add(1);
+        if (i >= tasks.size()) return;
+
+        tasks[i].fn(tasks[i].ctx, tasks[i].begin, tasks[i].end);
+
+        if (pending.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done_cv.notify_all();
+        }
+    }
+}
+
+void RenderPool::worker_loop(int index) {
+    char name[32];
+    snprintf(name, sizeof(name), "render worker %d", index);
+    trace_thread_name(name);
+
+    unsigned seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_cv.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            // Woke up after the batch was already finished by others
+            if (!batch) continue;
+            ++active;
+        }
+
+        drain();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active == 0) done_cv.notify_all();
+    }
+}
+
+// CPU quota of the cgroup this process runs in, or 0 if unlimited/unknown.
+// Limits apply hierarchically, so the smallest one on the path wins.
+static double cgroup_cpu_quota() {
+    std::ifstream cgroup_file("/proc/self/cgroup");
+    std::string line;
+    double quota = 0;
+
+    while (std::getline(cgroup_file, line)) {
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) continue;
+
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+
+        if (controllers.empty()) {
+            // cgroup v2: "max 100000" or "<quota> <period>" in cpu.max
+            for (;;) {
+                std::ifstream max_file("/sys/fs/cgroup" + path + "/cpu.max");
+                std::string max_str;
+                double period = 0;
+                if (max_file >> max_str >> period && max_str != "max" && period > 0) {
+                    double q = std::stod(max_str) / period;
+                    if (quota == 0 || q < quota) quota = q;
+                }
+                if (path.empty() || path == "/") break;
+                path = path.substr(0, path.rfind('/'));
+            }
+        } else if (controllers.find("cpu") != std::string::npos &&
+                   controllers.find("cpuset") == std::string::npos) {
+            // cgroup v1: cpu.cfs_quota_us is -1 when unlimited
+            std::string dirs[] = { "/sys/fs/cgroup/" + controllers + path, "/sys/fs/cgroup/cpu" };
+            for (const auto& dir : dirs) {
+                std::ifstream quota_file(dir + "/cpu.cfs_quota_us");
+                std::ifstream period_file(dir + "/cpu.cfs_period_us");
+                double q = 0, period = 0;
+                if (quota_file >> q && period_file >> period) {
+                    if (q > 0 && period > 0 && (quota == 0 || q / period < quota)) quota = q / period;
+                    break;
+                }
+            }
+        }
+    }
+    return quota;
+}
+
+int RenderPool::cpu_budget() {
+    int cpus = static_cast<int>(std::thread::hardware_concurrency());
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) cpus = CPU_COUNT(&set);
+
+    double quota = cgroup_cpu_quota();
+    if (quota > 0) cpus = std::min(cpus, static_cast<int>(std::ceil(quota)));
+
+    return std::max(cpus, 1);
+}
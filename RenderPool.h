@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#define CACHE_LINE_SIZE 64
+
+// One unit of render work: rows [begin, end) of whatever ctx describes
+struct RenderTask {
+    void (*fn)(void* ctx, size_t begin, size_t end);
+    void* ctx;
+    size_t begin, end;
+};
+
+// Persistent worker threads that execute batches of RenderTasks. The
+// threads are created once, sized to the CPU budget of the process, and
+// the calling thread works alongside them while it waits for a batch.
+class RenderPool {
+public:
+    // threads == 0 sizes the pool from cpu_budget()
+    explicit RenderPool(int threads = 0);
+    ~RenderPool();
+
+    RenderPool(const RenderPool&) = delete;
+    RenderPool& operator=(const RenderPool&) = delete;
+
+    // Split rows into bands whose first byte is cache-line aligned and
+    // append them to tasks
+    void split_rows(std::vector<RenderTask>& tasks, void (*fn)(void*, size_t, size_t),
+                    void* ctx, size_t rows, size_t stride) const;
+
+    // Same for rows [first, last) of a larger buffer: band boundaries sit on
+    // the same grid, so only the first band may start mid cache line
+    void split_rows(std::vector<RenderTask>& tasks, void (*fn)(void*, size_t, size_t),
+                    void* ctx, size_t first, size_t last, size_t stride) const;
+
+    // Run every task and return once all of them have finished
+    void run(const std::vector<RenderTask>& tasks);
+
+    // Threads taking part in run(), including the caller
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    // CPUs this process may use: affinity mask capped by the cgroup quota
+    static int cpu_budget();
+
+private:
+    void worker_loop(int index);
+    void drain();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+
+    const std::vector<RenderTask>* batch = nullptr;
+    std::atomic<size_t> next_task{0};
+    std::atomic<size_t> pending{0};
+    unsigned generation = 0;
+    int active = 0;             // Workers currently inside drain()
+    bool stopping = false;
+};
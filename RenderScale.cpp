@@ -0,0 +1,56 @@
+#include "RenderScale.h"
+
+#include <algorithm>
+
+// Frame time the model predicts at another step
+static double predict(double average_us, int from_percent, int to_percent) {
+    double ratio = static_cast<double>(to_percent) / from_percent;
+    return average_us * ratio * ratio;
+}
+
+bool RenderScale::record(uint64_t frame_us) {
+    if (!budget_us_) return set_step(0);
+
+    sum_us_ += frame_us;
+    if (++frames_ < WINDOW_FRAMES) return false;
+
+    double average = static_cast<double>(sum_us_) / frames_;
+    average_us_.store(static_cast<uint64_t>(average), std::memory_order_relaxed);
+    sum_us_ = 0;
+    frames_ = 0;
+
+    int step = step_.load(std::memory_order_relaxed);
+    int current = STEPS[step];
+    double budget = static_cast<double>(budget_us_);
+
+    if (average > budget) {
+        // Down right away, as far as needed
+        up_windows_ = 0;
+        int target = step;
+        while (target + 1 < STEP_COUNT && predict(average, current, STEPS[target]) > budget) ++target;
+        return set_step(target);
+    }
+
+    if (step > 0 && predict(average, current, STEPS[step - 1]) < budget * UP_HEADROOM) {
+        // Up one step at a time, once it has been safe for a while
+        if (++up_windows_ < UP_WINDOWS) return false;
+        up_windows_ = 0;
+        return set_step(step - 1);
+    }
+    up_windows_ = 0;
+    return false;
+}
+
+bool RenderScale::set_step(int step) {
+    int previous = step_.load(std::memory_order_relaxed);
+    if (step == previous) return false;
+
+    step_.store(step, std::memory_order_relaxed);
+    if (step > previous) downscales.fetch_add(1, std::memory_order_relaxed);
+    else upscales.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+int RenderScale::apply(int size) const {
+    return std::max(1, (size * percent() + 50) / 100);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Dynamic resolution: picks the scale a window renders at from its measured
+// frame times, so a render path that cannot keep up at native resolution
+// draws a smaller buffer for the compositor to upscale. Cost is modelled as
+// proportional to the pixel count, i.e. to the square of the scale.
+//
+// Frame times are averaged over WINDOW_FRAMES frames. A window over budget
+// drops straight to the largest step the model predicts fits; going back
+// up takes UP_WINDOWS windows in a row in which the next step up is
+// predicted to stay under UP_HEADROOM of the budget, so the scale does not
+// oscillate around the budget. Used by the thread drawing the window; the
+// counters are relaxed atomics so another thread may print them.
+class RenderScale {
+public:
+    static constexpr int STEPS[] = { 100, 90, 80, 70, 60, 50 };   // Percent of native
+    static constexpr int WINDOW_FRAMES = 30;
+    static constexpr int UP_WINDOWS = 3;
+    static constexpr double UP_HEADROOM = 0.8;
+
+    // Frame time to stay under; 0 disables scaling and returns to native
+    void set_budget(uint64_t budget_us) { budget_us_ = budget_us; }
+    uint64_t budget_us() const { return budget_us_; }
+
+    // Time spent rendering one frame at the current scale. Returns true
+    // when the scale changed.
+    bool record(uint64_t frame_us);
+
+    int percent() const { return STEPS[step_.load(std::memory_order_relaxed)]; }
+    uint64_t average_us() const { return average_us_.load(std::memory_order_relaxed); }
+
+    // Scale a native buffer dimension, never below one pixel
+    int apply(int size) const;
+
+    std::atomic<uint64_t> downscales{0};
+    std::atomic<uint64_t> upscales{0};
+
+private:
+    static constexpr int STEP_COUNT = sizeof(STEPS) / sizeof(STEPS[0]);
+
+    bool set_step(int step);
+
+    uint64_t budget_us_ = 0;
+    std::atomic<int> step_{0};
+    std::atomic<uint64_t> average_us_{0};   // Of the last complete window
+    uint64_t sum_us_ = 0;
+    int frames_ = 0;
+    int up_windows_ = 0;
+};
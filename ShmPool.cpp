@@ -0,0 +1,183 @@
+#include "ShmPool.h"
+#include "ProtocolStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <climits>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+ShmPool::Storage::~Storage() {
+    if (pool) {
+        wl_shm_pool_destroy(pool);
+        protocol_request();
+    }
+    if (map) munmap(map, size);
+    if (fd != -1) close(fd);
+}
+
+ShmPool::~ShmPool() {
+    destroy();
+}
+
+bool ShmPool::configure(struct wl_shm* shm, int width, int height, uint32_t format, int pixel_size) {
+    if (width == width_ && height == height_ && format == format_ && slots_[0].buffer)
+        return true;
+
+    retire_buffers();
+
+    size_t stride = static_cast<size_t>(width) * pixel_size;
+    size_t slot_size = stride * height;
+    size_t total = slot_size * SHM_POOL_SLOTS;
+    if (width <= 0 || height <= 0 || total > INT32_MAX) {
+        fprintf(stderr, "ShmPool: invalid buffer size %dx%d\n", width, height);
+        return false;
+    }
+
+    // The new slots would overlap memory the compositor is still reading
+    if (storage_ && storage_->held) {
+        retired_.push_back(std::move(storage_));
+    }
+
+    // A wl_shm_pool cannot shrink: smaller buffers (a render scale step
+    // down, a smaller window) get a memfd of their own size, so the memory
+    // goes back when the pressure does
+    if (storage_ && total < storage_->size) {
+        storage_.reset();
+    }
+
+    if (!storage_) {
+        std::unique_ptr<Storage> storage(new Storage);
+        storage->fd = memfd_create("wayland-buffer-pool", MFD_CLOEXEC);
+        if (storage->fd == -1) {
+            perror("memfd_create");
+            return false;
+        }
+        storage_ = std::move(storage);
+    }
+
+    if (total > storage_->size) {
+        if (ftruncate(storage_->fd, total) == -1) {
+            perror("ftruncate");
+            return false;
+        }
+
+        if (storage_->map) munmap(storage_->map, storage_->size);
+        storage_->map = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, storage_->fd, 0);
+        if (storage_->map == MAP_FAILED) {
+            perror("mmap");
+            storage_->map = nullptr;
+            storage_->size = 0;
+            return false;
+        }
+        storage_->size = total;
+
+        // wl_shm_pool.resize can only grow the pool
+        if (storage_->pool) {
+            wl_shm_pool_resize(storage_->pool, static_cast<int32_t>(total));
+            protocol_request();
+        } else {
+            storage_->pool = wl_shm_create_pool(shm, storage_->fd, static_cast<int32_t>(total));
+            protocol_request(1);
+        }
+    }
+
+    for (int i = 0; i < SHM_POOL_SLOTS; ++i) {
+        size_t offset = slot_size * i;
+        slots_[i] = Buffer();
+        slots_[i].buffer = wl_shm_pool_create_buffer(storage_->pool, static_cast<int32_t>(offset),
+                                                     width, height, static_cast<int32_t>(stride), format);
+        protocol_request();
+        slots_[i].data = static_cast<char*>(storage_->map) + offset;
+        slots_[i].owner = this;
+        slots_[i].storage = storage_.get();
+        wl_buffer_add_listener(slots_[i].buffer, &buffer_listener_impl, &slots_[i]);
+    }
+
+    width_ = width;
+    height_ = height;
+    stride_ = static_cast<int>(stride);
+    format_ = format;
+    return true;
+}
+
+ShmPool::Buffer* ShmPool::acquire() {
+    for (auto& slot : slots_) {
+        if (slot.buffer && !slot.busy) {
+            slot.busy = true;
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+void ShmPool::buffer_release(void* data, struct wl_buffer* buffer) {
+    Buffer* slot = static_cast<Buffer*>(data);
+    protocol_event(slot->owner->events_);
+    if (slot->stale) {
+        slot->owner->release_stale(slot);
+        return;
+    }
+    slot->busy = false;
+}
+
+// Free slots go now. A slot the compositor still holds may be on screen:
+// destroying it, or drawing over its memory, before wl_buffer.release
+// breaks the contract the pool relies on, so it waits for its release.
+void ShmPool::retire_buffers() {
+    for (auto& slot : slots_) {
+        if (!slot.buffer) continue;
+        if (slot.busy) {
+            std::unique_ptr<Buffer> stale(new Buffer(slot));
+            stale->stale = true;
+            stale->storage->held++;
+            wl_buffer_set_user_data(stale->buffer, stale.get());
+            stale_.push_back(std::move(stale));
+        } else {
+            wl_buffer_destroy(slot.buffer);
+            protocol_request();
+        }
+        slot = Buffer();
+    }
+    width_ = height_ = stride_ = 0;
+}
+
+void ShmPool::release_stale(Buffer* buffer) {
+    wl_buffer_destroy(buffer->buffer);
+    protocol_request();
+    Storage* storage = buffer->storage;
+    stale_.erase(std::find_if(stale_.begin(), stale_.end(),
+                              [buffer](const std::unique_ptr<Buffer>& b) { return b.get() == buffer; }));
+
+    if (--storage->held == 0) {
+        retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                      [storage](const std::unique_ptr<Storage>& s) { return s.get() == storage; }),
+                       retired_.end());
+    }
+}
+
+size_t ShmPool::mapped_size() const {
+    size_t size = storage_ ? storage_->size : 0;
+    for (const auto& storage : retired_) size += storage->size;
+    return size;
+}
+
+// The window is going away: nothing is waited for
+void ShmPool::destroy() {
+    for (auto& slot : slots_) {
+        if (slot.buffer) {
+            wl_buffer_destroy(slot.buffer);
+            protocol_request();
+        }
+        slot = Buffer();
+    }
+    for (auto& stale : stale_) {
+        wl_buffer_destroy(stale->buffer);
+        protocol_request();
+    }
+    stale_.clear();
+    retired_.clear();
+    storage_.reset();
+    width_ = height_ = stride_ = 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include <wayland-client.h>
+}
+
+struct ProtocolStats;
+
+// Number of wl_buffers carved from one pool (double buffering)
+#define SHM_POOL_SLOTS 2
+
+// Per-window set of wl_buffers backed by a single long-lived memfd.
+// Buffers are handed out by acquire() and become free again when the
+// compositor sends wl_buffer.release, so steady-state ticks do no
+// memfd/mmap/ftruncate work at all.
+class ShmPool {
+    struct Storage;
+
+public:
+    struct Buffer {
+        struct wl_buffer* buffer = nullptr;
+        void* data = nullptr;
+        bool busy = false;
+        uint64_t frame = 0;     // Frame last drawn into it, 0 if the contents are undefined
+
+        // Retired by configure() while the compositor still held it
+        bool stale = false;
+        ShmPool* owner = nullptr;
+        Storage* storage = nullptr;
+    };
+
+    ShmPool() = default;
+    ~ShmPool();
+
+    ShmPool(const ShmPool&) = delete;
+    ShmPool& operator=(const ShmPool&) = delete;
+
+    // (Re)carve the slots for a new buffer size; nothing is touched if the
+    // size is unchanged. Buffers the compositor still holds are retired:
+    // they stay alive, and so does the memory behind them, until their
+    // wl_buffer.release. The memfd is grown in place when it can be, and
+    // replaced by one of the new size when the buffers shrink or the old
+    // one is still held.
+    bool configure(struct wl_shm* shm, int width, int height, uint32_t format, int pixel_size);
+
+    // Returns a buffer the compositor is not reading from, or nullptr if
+    // every slot is still attached.
+    Buffer* acquire();
+
+    void destroy();
+
+    // wl_buffer.release events are charged to stats (PROTOCOL_STATS builds)
+    void count_events(ProtocolStats* stats) { events_ = stats; }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int stride() const { return stride_; }
+
+    // Current pool plus retired ones still held by the compositor
+    size_t mapped_size() const;
+
+private:
+    // A memfd, its mapping and the wl_shm_pool on it
+    struct Storage {
+        int fd = -1;
+        void* map = nullptr;
+        size_t size = 0;
+        struct wl_shm_pool* pool = nullptr;
+        int held = 0;           // Retired buffers not released yet
+
+        ~Storage();
+    };
+
+    static void buffer_release(void* data, struct wl_buffer* buffer);
+
+    static constexpr wl_buffer_listener buffer_listener_impl = {
+        .release = buffer_release
+    };
+
+    void retire_buffers();
+    void release_stale(Buffer* buffer);
+
+    std::unique_ptr<Storage> storage_;
+    std::vector<std::unique_ptr<Storage>> retired_;
+    std::vector<std::unique_ptr<Buffer>> stale_;
+
+    int width_ = 0, height_ = 0, stride_ = 0;
+    uint32_t format_ = 0;
+    ProtocolStats* events_ = nullptr;
+
+    Buffer slots_[SHM_POOL_SLOTS];
+};
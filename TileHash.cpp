@@ -0,0 +1,421 @@
+#include "TileHash.h"
+#include "PixelFill.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TILE_HASH_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#define TILE_HASH_NEON 1
+#endif
+
+// Every chunk of a row gets its own key and the accumulator is rotated
+// after every row, so moving data within the tile changes the hash
+#define TILE_HASH_KEY_CHUNKS 8
+#define TILE_HASH_ROW_ROTATE 17
+
+// "Much smaller than the upload it saves": the share of the saved upload
+// time the hash may cost
+#define TILE_HASH_MAX_SHARE 0.1
+
+struct TileHashKeys {
+    alignas(32) uint64_t init[4];
+    alignas(32) uint64_t chunk[TILE_HASH_KEY_CHUNKS][4];
+};
+
+static constexpr uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static constexpr TileHashKeys make_keys() {
+    TileHashKeys keys{};
+    uint64_t state = 0x54696C6548617368ull;
+    for (auto& v : keys.init) v = splitmix64(state);
+    for (auto& chunk : keys.chunk)
+        for (auto& v : chunk) v = splitmix64(state);
+    return keys;
+}
+
+static constexpr TileHashKeys keys = make_keys();
+
+static inline uint64_t fmix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    return h ^ (h >> 33);
+}
+
+static uint64_t finalize(const uint64_t acc[4], size_t row_bytes, size_t rows) {
+    uint64_t h = row_bytes * 0x9E3779B97F4A7C15ull ^ rows;
+    for (int lane = 0; lane < 4; ++lane) {
+        h = fmix64(h ^ acc[lane]);
+    }
+    return h;
+}
+
+// Four 64-bit lanes per 32-byte chunk: acc += lo32(d ^ key) * hi32(d ^ key),
+// plus the neighbouring lane's raw data so no input bit is lost. Nothing
+// but the additions depends on the previous chunk, so chunks pipeline.
+static inline void accumulate_scalar(uint64_t acc[4], const uint8_t* chunk, const uint64_t* key) {
+    uint64_t d[4];
+    memcpy(d, chunk, sizeof(d));
+    for (int lane = 0; lane < 4; ++lane) {
+        uint64_t dk = d[lane] ^ key[lane];
+        acc[lane] += (dk & 0xFFFFFFFFu) * (dk >> 32) + d[lane ^ 1];
+    }
+}
+
+static uint64_t hash_scalar(const uint8_t* data, size_t row_bytes, size_t rows, size_t stride) {
+    uint64_t acc[4] = { keys.init[0], keys.init[1], keys.init[2], keys.init[3] };
+    for (size_t row = 0; row < rows; ++row, data += stride) {
+        size_t offset = 0, chunk = 0;
+        for (; offset + 32 <= row_bytes; offset += 32, chunk = (chunk + 1) % TILE_HASH_KEY_CHUNKS) {
+            accumulate_scalar(acc, data + offset, keys.chunk[chunk]);
+        }
+        if (offset < row_bytes) {
+            uint8_t tail[32] = {};
+            memcpy(tail, data + offset, row_bytes - offset);
+            accumulate_scalar(acc, tail, keys.chunk[chunk]);
+        }
+        for (auto& lane : acc) {
+            lane = (lane << TILE_HASH_ROW_ROTATE) | (lane >> (64 - TILE_HASH_ROW_ROTATE));
+        }
+    }
+    return finalize(acc, row_bytes, rows);
+}
+
+#ifdef TILE_HASH_X86
+__attribute__((target("avx2")))
+static inline __m256i accumulate_avx2(__m256i acc, __m256i d, __m256i key) {
+    __m256i dk = _mm256_xor_si256(d, key);
+    __m256i product = _mm256_mul_epu32(dk, _mm256_srli_epi64(dk, 32));
+    __m256i swapped = _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+    return _mm256_add_epi64(acc, _mm256_add_epi64(product, swapped));
+}
+
+__attribute__((target("avx2")))
+static uint64_t hash_avx2(const uint8_t* data, size_t row_bytes, size_t rows, size_t stride) {
+    __m256i key[TILE_HASH_KEY_CHUNKS];
+    for (int c = 0; c < TILE_HASH_KEY_CHUNKS; ++c) {
+        key[c] = _mm256_load_si256(reinterpret_cast<const __m256i*>(keys.chunk[c]));
+    }
+    __m256i acc = _mm256_load_si256(reinterpret_cast<const __m256i*>(keys.init));
+
+    for (size_t row = 0; row < rows; ++row, data += stride) {
+        size_t offset = 0, chunk = 0;
+
+        // Whole key cycles (a full 64-pixel tile row) unrolled: the loop
+        // overhead, not the arithmetic, limits the rolled loop
+        for (; offset + 32 * TILE_HASH_KEY_CHUNKS <= row_bytes; offset += 32 * TILE_HASH_KEY_CHUNKS) {
+#pragma GCC unroll 8
+            for (int c = 0; c < TILE_HASH_KEY_CHUNKS; ++c) {
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset + 32 * c));
+                acc = accumulate_avx2(acc, d, key[c]);
+            }
+        }
+        for (; offset + 32 <= row_bytes; offset += 32, chunk = (chunk + 1) % TILE_HASH_KEY_CHUNKS) {
+            acc = accumulate_avx2(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset)), key[chunk]);
+        }
+        if (offset < row_bytes) {
+            alignas(32) uint8_t tail[32] = {};
+            memcpy(tail, data + offset, row_bytes - offset);
+            acc = accumulate_avx2(acc, _mm256_load_si256(reinterpret_cast<const __m256i*>(tail)), key[chunk]);
+        }
+        acc = _mm256_or_si256(_mm256_slli_epi64(acc, TILE_HASH_ROW_ROTATE),
+                              _mm256_srli_epi64(acc, 64 - TILE_HASH_ROW_ROTATE));
+    }
+
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return finalize(lanes, row_bytes, rows);
+}
+#endif
+
+#ifdef TILE_HASH_NEON
+static inline uint64x2_t accumulate_neon(uint64x2_t acc, uint64x2_t d, uint64x2_t key) {
+    uint64x2_t dk = veorq_u64(d, key);
+    uint64x2_t product = vmull_u32(vmovn_u64(dk), vshrn_n_u64(dk, 32));
+    uint64x2_t swapped = vextq_u64(d, d, 1);
+    return vaddq_u64(acc, vaddq_u64(product, swapped));
+}
+
+static inline uint64x2_t rotate_neon(uint64x2_t acc) {
+    return vorrq_u64(vshlq_n_u64(acc, TILE_HASH_ROW_ROTATE), vshrq_n_u64(acc, 64 - TILE_HASH_ROW_ROTATE));
+}
+
+static uint64_t hash_neon(const uint8_t* data, size_t row_bytes, size_t rows, size_t stride) {
+    uint64x2_t acc0 = vld1q_u64(keys.init), acc1 = vld1q_u64(keys.init + 2);
+
+    for (size_t row = 0; row < rows; ++row, data += stride) {
+        size_t offset = 0, chunk = 0;
+        for (; offset + 32 <= row_bytes; offset += 32, chunk = (chunk + 1) % TILE_HASH_KEY_CHUNKS) {
+            uint64x2_t d0 = vreinterpretq_u64_u8(vld1q_u8(data + offset));
+            uint64x2_t d1 = vreinterpretq_u64_u8(vld1q_u8(data + offset + 16));
+            acc0 = accumulate_neon(acc0, d0, vld1q_u64(keys.chunk[chunk]));
+            acc1 = accumulate_neon(acc1, d1, vld1q_u64(keys.chunk[chunk] + 2));
+        }
+        if (offset < row_bytes) {
+            uint8_t tail[32] = {};
+            memcpy(tail, data + offset, row_bytes - offset);
+            acc0 = accumulate_neon(acc0, vreinterpretq_u64_u8(vld1q_u8(tail)), vld1q_u64(keys.chunk[chunk]));
+            acc1 = accumulate_neon(acc1, vreinterpretq_u64_u8(vld1q_u8(tail + 16)), vld1q_u64(keys.chunk[chunk] + 2));
+        }
+        acc0 = rotate_neon(acc0);
+        acc1 = rotate_neon(acc1);
+    }
+
+    uint64_t lanes[4];
+    vst1q_u64(lanes, acc0);
+    vst1q_u64(lanes + 2, acc1);
+    return finalize(lanes, row_bytes, rows);
+}
+#endif
+
+static const TileHashKernel scalar_kernel = { "scalar", hash_scalar };
+#ifdef TILE_HASH_X86
+static const TileHashKernel avx2_kernel = { "AVX2", hash_avx2 };
+#endif
+#ifdef TILE_HASH_NEON
+static const TileHashKernel neon_kernel = { "NEON", hash_neon };
+#endif
+
+static const TileHashKernel* active_kernel = &scalar_kernel;
+
+// Kernels usable on this CPU, worst first
+static std::vector<const TileHashKernel*> supported_kernels() {
+    std::vector<const TileHashKernel*> kernels = { &scalar_kernel };
+#ifdef TILE_HASH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) kernels.push_back(&avx2_kernel);
+#endif
+#ifdef TILE_HASH_NEON
+    if (getauxval(AT_HWCAP) & HWCAP_ASIMD) kernels.push_back(&neon_kernel);
+#endif
+    return kernels;
+}
+
+void tile_hash_init() {
+    active_kernel = supported_kernels().back();
+}
+
+const TileHashKernel& tile_hash_kernel() {
+    return *active_kernel;
+}
+
+uint64_t tile_hash(const uint8_t* data, size_t row_bytes, size_t rows, size_t stride) {
+    return active_kernel->hash(data, row_bytes, rows, stride);
+}
+
+void TileHasher::resize(int width, int height, int pixel_size) {
+    size_t count = static_cast<size_t>((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE);
+    if (width == width_ && height == height_ && pixel_size == pixel_size_ && hashes_.size() == count) return;
+    width_ = width;
+    height_ = height;
+    pixel_size_ = pixel_size;
+    hashes_.assign(count, 0);
+    dirty_.assign(count, 1);
+    fresh_ = true;
+}
+
+void TileHasher::hash_rows(const void* pixels, size_t stride, size_t first, size_t last) {
+    const uint8_t* base = static_cast<const uint8_t*>(pixels);
+    int columns = this->columns();
+    last = std::min(last, static_cast<size_t>(rows()));
+
+    for (size_t ty = first; ty < last; ++ty) {
+        int y = static_cast<int>(ty) * TILE_SIZE;
+        int tile_height = std::min(TILE_SIZE, height_ - y);
+        for (int tx = 0; tx < columns; ++tx) {
+            int x = tx * TILE_SIZE;
+            int tile_width = std::min(TILE_SIZE, width_ - x);
+            uint64_t hash = tile_hash(base + y * stride + x * pixel_size_,
+                                      tile_width * pixel_size_, tile_height, stride);
+            size_t index = ty * columns + tx;
+            dirty_[index] = fresh_ || hash != hashes_[index];
+            hashes_[index] = hash;
+        }
+    }
+}
+
+size_t TileHasher::collect(DamageRegion& damage) {
+    int columns = this->columns();
+    size_t changed = 0;
+    for (int ty = 0; ty < rows(); ++ty) {
+        int y = ty * TILE_SIZE;
+        int tile_height = std::min(TILE_SIZE, height_ - y);
+        int run = -1;   // First tile of the current run of changed tiles
+
+        for (int tx = 0; tx <= columns; ++tx) {
+            if (tx < columns && dirty_[static_cast<size_t>(ty) * columns + tx]) {
+                ++changed;
+                if (run < 0) run = tx;
+            } else if (run >= 0) {
+                int x = run * TILE_SIZE;
+                damage.add({ x, y, std::min(tx * TILE_SIZE, width_) - x, tile_height });
+                run = -1;
+            }
+        }
+    }
+    fresh_ = false;
+    return changed;
+}
+
+bool tile_hash_self_test() {
+    // A tile 60 pixels wide, so every row ends in a partial chunk, over noise
+    const int width = 64, height = 64;
+    const size_t stride = width * sizeof(uint32_t);
+    std::vector<uint32_t> pixels(width * height);
+    for (int i = 0; i < width * height; ++i) pixels[i] = static_cast<uint32_t>(i * 2654435761u);
+    const size_t tile_bytes = 60 * sizeof(uint32_t);
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(pixels.data());
+
+    uint64_t reference = hash_scalar(base, tile_bytes, height, stride);
+    for (const TileHashKernel* kernel : supported_kernels()) {
+        uint64_t hash = kernel->hash(base, tile_bytes, height, stride);
+        if (hash != reference) return false;
+
+        std::swap_ranges(pixels.begin(), pixels.begin() + tile_bytes / 4, pixels.begin() + width);
+        bool swapped = kernel->hash(base, tile_bytes, height, stride) != hash;
+        std::swap_ranges(pixels.begin(), pixels.begin() + tile_bytes / 4, pixels.begin() + width);
+
+        pixels[width * (height - 1) + 1] ^= 1;
+        bool changed = kernel->hash(base, tile_bytes, height, stride) != hash;
+        pixels[width * (height - 1) + 1] ^= 1;
+        if (!swapped || !changed) return false;
+    }
+    return true;
+}
+
+int tile_hash_benchmark(int width, int height, int frames) {
+    tile_hash_init();
+
+    size_t stride = static_cast<size_t>(width) * sizeof(uint32_t);
+    size_t bytes = stride * height;
+
+    // The buffer is mapped like an SHM pool slot; the texture stands in for
+    // the compositor's copy, so a memcpy of the damage is the cheapest
+    // possible upload
+    void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    uint32_t* pixels = static_cast<uint32_t*>(mem);
+    std::vector<uint8_t> texture(bytes);
+    memset(pixels, 0, bytes);
+
+    std::cout << "\n=== TILE HASH BENCHMARK " << width << "x" << height << " ("
+              << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MiB, "
+              << TileHasher::TILE_SIZE << "x" << TileHasher::TILE_SIZE << " tiles, " << frames << " frames) ===\n";
+
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(pixels);
+
+    // A full-width bar sweeping the buffer, redrawn from scratch every frame
+    // the way a producer without damage information would
+    const int bar_height = std::min(64, height);
+    bool stream = pixel_fill_streams(bytes);
+    auto draw = [&](int frame, int first, int last, bool stream) {
+        int bar_y = static_cast<int>(static_cast<int64_t>(frame) * 8 % std::max(1, height - bar_height + 1));
+        int bar_first = std::max(first, bar_y), bar_last = std::min(last, bar_y + bar_height);
+        pixel_fill(pixels + static_cast<size_t>(first) * width, static_cast<size_t>(last - first) * width, 0x00336699u, stream);
+        if (bar_first < bar_last) {
+            pixel_fill(pixels + static_cast<size_t>(bar_first) * width,
+                       static_cast<size_t>(bar_last - bar_first) * width, 0x00CC9966u, stream);
+        }
+    };
+
+    auto ms_since = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    TileHasher hasher;
+    DamageRegion damage;
+    std::vector<double> hash_ms, full_ms, damaged_ms;
+    double damaged_fraction = 0;
+    for (int frame = 0; frame <= frames; ++frame) {
+        // Hash each tile row right after drawing it, while it is in cache,
+        // the way the render tasks do
+        hasher.resize(width, height);
+        double hash = 0;
+        for (int ty = 0; ty < hasher.rows(); ++ty) {
+            int first = ty * TileHasher::TILE_SIZE;
+            draw(frame, first, std::min(height, first + TileHasher::TILE_SIZE), false);
+            auto start = std::chrono::steady_clock::now();
+            hasher.hash_rows(pixels, stride, ty, ty + 1);
+            hash += ms_since(start);
+        }
+        damage.clear();
+        hasher.collect(damage);
+
+        // Redrawn before each copy so both start from the same cache state
+        draw(frame, 0, height, stream);
+        auto start = std::chrono::steady_clock::now();
+        memcpy(texture.data(), pixels, bytes);
+        double full = ms_since(start);
+
+        draw(frame, 0, height, stream);
+        start = std::chrono::steady_clock::now();
+        for (const Rect& rect : damage.rects()) {
+            for (int y = rect.y; y < rect.y + rect.height; ++y) {
+                size_t offset = y * stride + rect.x * sizeof(uint32_t);
+                memcpy(texture.data() + offset, base + offset, rect.width * sizeof(uint32_t));
+            }
+        }
+        double damaged = ms_since(start);
+
+        // The first frame damages everything
+        if (frame == 0) continue;
+        hash_ms.push_back(hash);
+        full_ms.push_back(full);
+        damaged_ms.push_back(damaged);
+        damaged_fraction += static_cast<double>(damage.area()) / (static_cast<double>(width) * height);
+    }
+    if (hash_ms.empty()) {
+        munmap(mem, bytes);
+        return 1;
+    }
+
+    auto median = [](std::vector<double>& times) {
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    };
+    double hash = median(hash_ms);
+    double full = median(full_ms), damaged = median(damaged_ms);
+    double saved = full - damaged;
+
+    // A memcpy is the cheapest upload a compositor can do; texture uploads
+    // through the GPU driver cost more, so the savings are a lower bound
+    auto report = [&](const char* name, double ms) {
+        std::cout << std::left << std::setw(22) << name << std::right << std::setprecision(3)
+                  << std::setw(8) << ms << " ms " << std::setprecision(2)
+                  << std::setw(7) << bytes / (ms * 1e6) << " GB/s " << std::setprecision(1)
+                  << std::setw(6) << (saved > 0 ? 100.0 * ms / saved : 0) << "% of saved upload\n";
+    };
+    std::cout << "Kernel " << active_kernel->name << ", " << std::setprecision(1)
+              << 100.0 * damaged_fraction / hash_ms.size() << "% of pixels damaged per frame\n"
+              << std::setprecision(3)
+              << "full upload (memcpy)  " << std::setw(8) << full << " ms\n"
+              << "damaged upload        " << std::setw(8) << damaged << " ms\n"
+              << "saved per frame       " << std::setw(8) << saved << " ms\n";
+    report("hash fused with draw", hash);
+    if (saved <= 0 || hash > saved * TILE_HASH_MAX_SHARE) {
+        std::cout << "⚠️  Hashing is not much cheaper than the upload it saves (target: under "
+                  << std::setprecision(0) << 100 * TILE_HASH_MAX_SHARE << "%)\n";
+    }
+
+    munmap(mem, bytes);
+    return 0;
+}
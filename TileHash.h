@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Damage.h"
+
+// Change detection for content whose damage is unknown (plugins, imported
+// frames): the buffer (any pixel format) is cut into TILE_SIZE x TILE_SIZE
+// tiles, each tile row is hashed right after it is drawn, while it is still
+// in cache, and only tiles whose hash differs from the previous frame are
+// damaged. Hashing a finished buffer after the fact reads it back from
+// memory and costs most of the upload it saves, so there is no API for it.
+//
+// The hash is a keyed multiply-accumulate over 32-byte chunks (the XXH3
+// inner loop), selected once at startup from the CPU features (AVX2 on
+// x86-64, NEON on ARM, scalar otherwise). All kernels produce the same
+// hash. Even fused with drawing it still costs a large share of the upload
+// it saves (see --bench-tiles), so it is only used when asked for
+// (--tile-damage).
+
+typedef uint64_t (*tile_hash_fn)(const uint8_t* data, size_t row_bytes, size_t rows, size_t stride);
+
+struct TileHashKernel {
+    const char* name;
+    tile_hash_fn hash;
+};
+
+// Detect CPU features, select the best kernel
+void tile_hash_init();
+
+const TileHashKernel& tile_hash_kernel();
+
+// Hash rows rows of row_bytes bytes each, stride bytes apart
+uint64_t tile_hash(const uint8_t* data, size_t row_bytes, size_t rows, size_t stride);
+
+class TileHasher {
+public:
+    static constexpr int TILE_SIZE = 64;
+
+    // Buffer size for the next frame; after a change every tile counts as
+    // changed
+    void resize(int width, int height, int pixel_size = 4);
+    void reset() { hashes_.clear(); }
+
+    // Hash tile rows [first, last) of the buffer. Calls for disjoint ranges
+    // may run concurrently, e.g. right after the render task that filled
+    // those rows, while they are still in cache.
+    void hash_rows(const void* pixels, size_t stride, size_t first, size_t last);
+
+    // Add the tiles that changed since the previous frame to damage, as runs
+    // of adjacent tiles, and return their number
+    size_t collect(DamageRegion& damage);
+
+    int rows() const { return (height_ + TILE_SIZE - 1) / TILE_SIZE; }
+    int columns() const { return (width_ + TILE_SIZE - 1) / TILE_SIZE; }
+    size_t tiles() const { return hashes_.size(); }
+
+private:
+    int width_ = 0, height_ = 0, pixel_size_ = 4;
+    bool fresh_ = true;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint8_t> dirty_;
+};
+
+// Checks every kernel against the scalar one and that a swapped pair of
+// rows and a single changed pixel change the hash. Returns false on the
+// first failure.
+bool tile_hash_self_test();
+
+// Cost of hashing each tile row as it is drawn, against the upload it saves
+// for an animated bar sweeping a buffer of this size
+int tile_hash_benchmark(int width, int height, int frames);
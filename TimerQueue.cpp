@@ -0,0 +1,142 @@
+#include "TimerQueue.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+TimerQueue::TimerQueue() {}
+
+TimerQueue::~TimerQueue() {
+    if (fd_ != -1) close(fd_);
+}
+
+bool TimerQueue::init() {
+    fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd_ == -1) {
+        perror("timerfd_create");
+        return false;
+    }
+    return true;
+}
+
+uint64_t TimerQueue::now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+int TimerQueue::add(const char* name, uint64_t interval_ns, bool repeat, timer_fn fn, void* data) {
+    if (fd_ == -1 || interval_ns == 0) return -1;
+
+    Timer timer;
+    timer.name = name;
+    timer.interval = interval_ns;
+    timer.deadline = now_ns() + interval_ns;
+    timer.repeat = repeat;
+    timer.active = true;
+    timer.fn = fn;
+    timer.data = data;
+
+    int id = static_cast<int>(timers.size());
+    timers.push_back(timer);
+    deadlines.emplace(timer.deadline, id);
+    arm();
+    return id;
+}
+
+void TimerQueue::cancel(int id) {
+    if (id < 0 || id >= static_cast<int>(timers.size()) || !timers[id].active) return;
+    deadlines.erase({ timers[id].deadline, id });
+    timers[id].active = false;
+    timers[id].paused = false;
+    arm();
+}
+
+void TimerQueue::pause(int id) {
+    if (id < 0 || id >= static_cast<int>(timers.size()) || !timers[id].active || timers[id].paused) return;
+    deadlines.erase({ timers[id].deadline, id });
+    timers[id].paused = true;
+    arm();
+}
+
+uint64_t TimerQueue::resume(int id) {
+    if (id < 0 || id >= static_cast<int>(timers.size()) || !timers[id].paused) return 0;
+
+    Timer& timer = timers[id];
+    uint64_t now = now_ns();
+    uint64_t skipped = 0;
+    if (timer.repeat && timer.deadline <= now) {
+        skipped = (now - timer.deadline) / timer.interval + 1;
+        timer.deadline += skipped * timer.interval;
+        timer.stats.skipped += skipped;
+    }
+    timer.paused = false;
+    deadlines.emplace(timer.deadline, id);
+    arm();
+    return skipped;
+}
+
+void TimerQueue::dispatch() {
+    uint64_t expirations;
+    if (read(fd_, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+        perror("timerfd read");
+    }
+
+    uint64_t now = now_ns();
+    while (!deadlines.empty() && deadlines.begin()->first <= now) {
+        int id = deadlines.begin()->second;
+        deadlines.erase(deadlines.begin());
+
+        Timer& timer = timers[id];
+        uint64_t late = now - timer.deadline;
+        timer.stats.fired++;
+        timer.stats.late_ns_total += late;
+        if (late > timer.stats.late_ns_max) timer.stats.late_ns_max = late;
+
+        if (timer.repeat) {
+            // Stay on the original grid; whole periods we slept through are missed
+            uint64_t missed = late / timer.interval;
+            timer.stats.missed += missed;
+            timer.deadline += (missed + 1) * timer.interval;
+            deadlines.emplace(timer.deadline, id);
+        } else {
+            timer.active = false;
+        }
+
+        // The callback may add timers, which can move the vector
+        timer_fn fn = timer.fn;
+        void* data = timer.data;
+        fn(data);
+
+        now = now_ns();
+    }
+
+    arm();
+}
+
+void TimerQueue::arm() {
+    struct itimerspec spec = {};
+    if (!deadlines.empty()) {
+        uint64_t deadline = deadlines.begin()->first;
+        spec.it_value.tv_sec = deadline / 1000000000ull;
+        spec.it_value.tv_nsec = deadline % 1000000000ull;
+    }
+    if (timerfd_settime(fd_, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        perror("timerfd_settime");
+    }
+}
+
+void TimerQueue::print_stats() const {
+    std::cout << "\n=== TIMER STATS ===\n";
+    for (const auto& timer : timers) {
+        const Stats& s = timer.stats;
+        double mean_us = s.fired ? s.late_ns_total / 1000.0 / s.fired : 0.0;
+        std::cout << "⏲️  " << timer.name << ": fired " << s.fired << ", missed " << s.missed
+                  << ", skipped while paused " << s.skipped
+                  << ", lateness mean " << mean_us << " us, max " << s.late_ns_max / 1000.0 << " us\n";
+    }
+    std::cout << "===================\n";
+}
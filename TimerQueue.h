@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Timers multiplexed onto one timerfd that is polled next to the Wayland
+// display fd. Deadlines are absolute CLOCK_MONOTONIC times: a repeating
+// timer's next deadline is its previous deadline plus the interval, so late
+// wakeups never accumulate into drift. Periods skipped because the loop
+// was blocked for longer than the interval are counted as missed.
+class TimerQueue {
+public:
+    typedef void (*timer_fn)(void* data);
+
+    struct Stats {
+        uint64_t fired = 0;
+        uint64_t missed = 0;        // Whole periods skipped
+        uint64_t late_ns_total = 0;
+        uint64_t late_ns_max = 0;   // Worst delay between deadline and callback
+        uint64_t skipped = 0;       // Periods that passed while paused
+    };
+
+    TimerQueue();
+    ~TimerQueue();
+
+    TimerQueue(const TimerQueue&) = delete;
+    TimerQueue& operator=(const TimerQueue&) = delete;
+
+    bool init();
+    int fd() const { return fd_; }
+
+    // First expiry at now + interval. interval_ns repeats when repeat is set.
+    // Returns an id for cancel()/stats(), or -1 on error.
+    int add(const char* name, uint64_t interval_ns, bool repeat, timer_fn fn, void* data);
+    void cancel(int id);
+
+    // Take a timer off the timerfd without losing its grid. resume() puts it
+    // back on the same grid and returns the deadlines that passed while it
+    // was paused, which are not fired: the owner catches up in one step.
+    void pause(int id);
+    uint64_t resume(int id);
+
+    // Call when fd() is readable: runs every timer that is due and re-arms
+    void dispatch();
+
+    const Stats& stats(int id) const { return timers[id].stats; }
+    void print_stats() const;
+
+    static uint64_t now_ns();
+
+private:
+    struct Timer {
+        const char* name = nullptr;
+        uint64_t deadline = 0;
+        uint64_t interval = 0;
+        bool repeat = false;
+        bool active = false;
+        bool paused = false;
+        timer_fn fn = nullptr;
+        void* data = nullptr;
+        Stats stats;
+    };
+
+    void arm();
+
+    int fd_ = -1;
+    std::vector<Timer> timers;                      // Indexed by id
+    std::set<std::pair<uint64_t, int>> deadlines;   // (deadline, id), earliest first
+};
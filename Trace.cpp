@@ -0,0 +1,150 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// Chrome's track ids are thread ids; window tracks get ids no thread has
+#define TRACK_TID_BASE 0x40000000
+
+// Written only by its thread. trace_write() copies it while that thread
+// may still be recording and drops whatever could have been overwritten
+// during the copy.
+struct TraceBuffer {
+    long tid;
+    char name[32];
+    std::atomic<uint64_t> head{0};       // Events recorded so far
+    TraceEvent events[TRACE_RING_EVENTS];
+};
+
+std::atomic<bool> trace_enabled_flag{false};
+
+static std::mutex buffers_mutex;
+static std::vector<std::unique_ptr<TraceBuffer>> buffers;   // Kept after their thread exits
+static std::string trace_path;
+static thread_local TraceBuffer* buffer = nullptr;
+static thread_local char pending_name[32];                   // Named before the first event
+
+uint64_t trace_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+// First event of a thread: allocates, once
+static TraceBuffer* thread_buffer() {
+    if (buffer) return buffer;
+    std::unique_ptr<TraceBuffer> created(new TraceBuffer);
+    created->tid = syscall(SYS_gettid);
+    memcpy(created->name, pending_name, sizeof(created->name));
+    buffer = created.get();
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buffers.push_back(std::move(created));
+    return buffer;
+}
+
+void trace_start(const char* path) {
+    trace_path = path;
+    trace_enabled_flag.store(true, std::memory_order_relaxed);
+}
+
+void trace_thread_name(const char* name) {
+    snprintf(pending_name, sizeof(pending_name), "%s", name);
+    if (buffer) {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        memcpy(buffer->name, pending_name, sizeof(buffer->name));
+    }
+}
+
+void trace_record(const char* name, uint64_t start_ns, uint64_t end_ns, int window, TracePhase phase) {
+    TraceBuffer* ring = thread_buffer();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    TraceEvent& event = ring->events[head & (TRACE_RING_EVENTS - 1)];
+    event.name = name;
+    event.start_ns = start_ns;
+    event.duration_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+    event.window = window;
+    event.phase = phase;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+static void write_event(FILE* file, const TraceEvent& event, int pid, long tid, bool& first) {
+    if (event.phase == TracePhase::Track) tid = TRACK_TID_BASE + (event.window < 0 ? 0 : event.window);
+    fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"%s\",\"ts\":%llu.%03llu,",
+            first ? "" : ",", event.name, event.phase == TracePhase::Instant ? "i" : "X",
+            static_cast<unsigned long long>(event.start_ns / 1000),
+            static_cast<unsigned long long>(event.start_ns % 1000));
+    if (event.phase == TracePhase::Instant) {
+        fprintf(file, "\"s\":\"t\",");
+    } else {
+        fprintf(file, "\"dur\":%llu.%03llu,", static_cast<unsigned long long>(event.duration_ns / 1000),
+                static_cast<unsigned long long>(event.duration_ns % 1000));
+    }
+    fprintf(file, "\"pid\":%d,\"tid\":%ld", pid, tid);
+    if (event.window >= 0) fprintf(file, ",\"args\":{\"window\":%d}", event.window + 1);
+    fprintf(file, "}");
+    first = false;
+}
+
+static void write_thread_name(FILE* file, int pid, long tid, const char* name, bool& first) {
+    fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",", pid, tid, name);
+    first = false;
+}
+
+long trace_write() {
+    if (trace_path.empty()) return -1;
+    FILE* file = fopen(trace_path.c_str(), "w");
+    if (!file) return -1;
+
+    int pid = getpid();
+    bool first = true;
+    long written = 0;
+    std::vector<bool> tracks;
+    std::vector<TraceEvent> copy(TRACE_RING_EVENTS);
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (auto& ring : buffers) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        for (uint64_t i = begin; i < head; ++i) {
+            copy[i - begin] = ring->events[i & (TRACE_RING_EVENTS - 1)];
+        }
+        // Slots the thread reached again while we copied, including the
+        // one it may be writing right now
+        uint64_t now = ring->head.load(std::memory_order_acquire) + 1;
+        uint64_t valid = now > TRACE_RING_EVENTS ? now - TRACE_RING_EVENTS : 0;
+
+        char fallback[32];
+        snprintf(fallback, sizeof(fallback), "thread %ld", ring->tid);
+        write_thread_name(file, pid, ring->tid, ring->name[0] ? ring->name : fallback, first);
+        for (uint64_t i = std::max(begin, valid); i < head; ++i) {
+            const TraceEvent& event = copy[i - begin];
+            if (event.phase == TracePhase::Track && event.window >= 0) {
+                if (tracks.size() <= static_cast<size_t>(event.window)) tracks.resize(event.window + 1);
+                tracks[event.window] = true;
+            }
+            write_event(file, event, pid, ring->tid, first);
+            written++;
+        }
+    }
+    for (size_t window = 0; window < tracks.size(); ++window) {
+        if (!tracks[window]) continue;
+        char name[48];
+        snprintf(name, sizeof(name), "Window %zu presented", window + 1);
+        write_thread_name(file, pid, TRACK_TID_BASE + static_cast<long>(window), name, first);
+    }
+    fprintf(file, "\n]}\n");
+
+    bool failed = ferror(file);
+    if (fclose(file) != 0 || failed) return -1;
+    return written;
+}
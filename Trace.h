@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Frame lifecycle trace: where the time between a poll() wakeup and the
+// pixels landing went, on every thread. Spans are recorded into a fixed
+// ring per thread (the most recent TRACE_RING_EVENTS survive) and written
+// out as Chrome trace event JSON, which chrome://tracing, Perfetto's UI and
+// speedscope all load.
+//
+//     TraceSpan span("commit", win.index);
+//
+// Tracing is off unless trace_start() is called (--trace FILE); a span then
+// costs one relaxed load. Span names must be string literals, only the
+// pointer is stored.
+
+#define TRACE_RING_EVENTS 16384      // Per thread, power of two
+
+enum class TracePhase : uint8_t {
+    Span,                            // On the recording thread
+    Instant,
+    Track                            // On the window's own track, e.g. commit to presentation
+};
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start_ns;               // CLOCK_MONOTONIC
+    uint64_t duration_ns;
+    int32_t window;                  // Window index, -1 for none
+    TracePhase phase;
+};
+
+extern std::atomic<bool> trace_enabled_flag;
+
+inline bool trace_enabled() {
+    return trace_enabled_flag.load(std::memory_order_relaxed);
+}
+
+uint64_t trace_now_ns();
+
+// Start recording; trace_write() writes everything recorded so far to path
+void trace_start(const char* path);
+
+// Write the trace file, replacing an earlier one. Returns the number of
+// events written, or -1 on error. Not for the hot path.
+long trace_write();
+
+// Name the calling thread in the trace
+void trace_thread_name(const char* name);
+
+void trace_record(const char* name, uint64_t start_ns, uint64_t end_ns, int window, TracePhase phase);
+
+inline void trace_instant(const char* name, int window = -1) {
+    if (trace_enabled()) trace_record(name, trace_now_ns(), 0, window, TracePhase::Instant);
+}
+
+// A span that did not happen on one thread, e.g. from commit to
+// presentation; shown on a track of its own per window
+inline void trace_track(const char* name, uint64_t start_ns, uint64_t end_ns, int window) {
+    if (trace_enabled()) trace_record(name, start_ns, end_ns, window, TracePhase::Track);
+}
+
+// Records the time from construction to destruction
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, int window = -1)
+        : name_(name), window_(window), start_ns_(trace_enabled() ? trace_now_ns() : 0) {}
+
+    ~TraceSpan() {
+        if (start_ns_) trace_record(name_, start_ns_, trace_now_ns(), window_, TracePhase::Span);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    int window_;
+    uint64_t start_ns_;
+};